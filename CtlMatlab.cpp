@@ -4,14 +4,24 @@
 #include <stdio.h>
 #include <exception>
 #include <list>
+#include <map>
+#include <string>
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <errno.h>
 #include "transform.hh"
+#include "job.hh"
+#include "lut.hh"
+#include "sequence.hh"
+#include "render_cache.hh"
+#include "region.hh"
+#include "buffer_pool.hh"
+#include <memory>
 #include <Iex.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <math.h>
 
 #if !defined(TRUE) 
 #define TRUE 1
@@ -51,6 +61,51 @@ double getfloat(const char *param, const char *name, ...)
 	return result;
 }
 
+// Parses the values of -sweep, <start>:<step>:<stop> or <start>:<stop>
+// (a step of 1) as MATLAB's colon does. The last value is kept when
+// rounding leaves it a hair past stop.
+bool parse_sweep_values(const char *range, std::vector<float> *values)
+{
+    double bounds[3];
+    int n = 0;
+    const char *p = range;
+    char *end;
+    
+    while (n < 3)
+    {
+        bounds[n++] = strtod(p, &end);
+        if (end == p || (*end != ':' && *end != 0))
+        {
+            return false;
+        }
+        if (*end == 0)
+        {
+            break;
+        }
+        p = end + 1;
+    }
+    if (n < 2 || *end != 0)
+    {
+        return false;
+    }
+    
+    double start = bounds[0];
+    double step = n == 3 ? bounds[1] : 1.0;
+    double stop = bounds[n - 1];
+    if (step == 0.0 || (stop - start) / step < 0.0)
+    {
+        return false;
+    }
+    
+    size_t count = (size_t) floor((stop - start) / step + 1e-6) + 1;
+    values->clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        values->push_back((float) (start + i * step));
+    }
+    return true;
+}
+
 ctl_parameter_t get_ctl_parameter(const char ***_argv, int *_argc, int start_argc, const char *type, int count)
 {
 	ctl_parameter_t new_ctl_param;
@@ -111,27 +166,1015 @@ file_format_t allowed_formats[] =
 
 const format_t &find_format(const char *fmt, const char *message = NULL)
 {
-	const file_format_t *current = allowed_formats;
-    
-	while (current->name != NULL)
+	const file_format_t *current = allowed_formats;
+    
+	while (current->name != NULL)
+	{
+		if (!strcmp(current->name, fmt))
+		{
+			return current->output_fmt;
+		}
+		current++;
+	}
+	mexPrintf("Unrecognized format '%s'%s", fmt, message ? message : ".");
+    mexErrMsgTxt("Throwing error\n");
+    // Error should be thrown before reaching here.
+	return current->output_fmt;
+}
+
+int verbosity = 1;
+
+// Only the pixels of the clipped region are copied.
+template <class T>
+void copy_mxarray_to_fb(const T *data, float input_scale, mwSize height, mwSize width, mwSize depth, const region_t &clipped, float *pixels)
+{
+    float scale = input_scale != 0.0 ? input_scale : 1.0;
+    mwSize columns = region_columns(clipped);
+    mwSize rows = region_rows(clipped);
+    
+    // MATLAB stores the planes column major, the framebuffer is row major
+    // and interleaved.
+    for (mwSize c = 0; c < depth; c++)
+    {
+        for (mwSize x = 0; x < columns; x++)
+        {
+            const T *in = data + (c * width + clipped.x + x * clipped.step) * height + clipped.y;
+            float *out = pixels + x * depth + c;
+            for (mwSize y = 0; y < rows; y++)
+            {
+                out[y * columns * depth] = (float) in[y * clipped.step] * scale;
+            }
+        }
+    }
+}
+
+template <class T>
+void copy_fb_to_mxarray(const float *pixels, float output_scale, mwSize height, mwSize width, mwSize depth, T *data)
+{
+    float scale = output_scale != 0.0 ? output_scale : 1.0;
+    
+    for (mwSize c = 0; c < depth; c++)
+    {
+        for (mwSize x = 0; x < width; x++)
+        {
+            const float *in = pixels + x * depth + c;
+            for (mwSize y = 0; y < height; y++)
+            {
+                *(data++) = (T) (in[y * width * depth] / scale);
+            }
+        }
+    }
+}
+
+// Fills image_buffer from the region of an H x W x C single or double
+// array. As with the floating point file formats the input scale
+// multiplies the samples.
+void mxarray_to_fb(const mxArray *array, float input_scale, const region_t &region, ctl::dpx::fb<float> *image_buffer)
+{
+    mwSize ndims = mxGetNumberOfDimensions(array);
+    const mwSize *dims = mxGetDimensions(array);
+    mwSize depth = ndims > 2 ? dims[2] : 1;
+    
+    if (ndims > 3 || (depth != 1 && depth != 3 && depth != 4))
+    {
+        mexErrMsgTxt("Input image array must be H x W, H x W x 3 or H x W x 4");
+    }
+    
+    region_t clipped = clip_region(region, dims[1], dims[0]);
+    image_buffer->init(region_columns(clipped), region_rows(clipped), depth);
+    if (mxIsSingle(array))
+    {
+        copy_mxarray_to_fb((const float *) mxGetData(array), input_scale, dims[0], dims[1], depth, clipped, image_buffer->ptr());
+    }
+    else
+    {
+        copy_mxarray_to_fb((const double *) mxGetData(array), input_scale, dims[0], dims[1], depth, clipped, image_buffer->ptr());
+    }
+}
+
+// Returns image_buffer as an H x W x C array of class class_id. The output
+// scale divides the samples.
+mxArray *fb_to_mxarray(const ctl::dpx::fb<float> &image_buffer, float output_scale, mxClassID class_id)
+{
+    mwSize dims[3];
+    mxArray *array;
+    
+    dims[0] = image_buffer.height();
+    dims[1] = image_buffer.width();
+    dims[2] = image_buffer.depth();
+    array = mxCreateNumericArray(3, dims, class_id, mxREAL);
+    
+    if (class_id == mxSINGLE_CLASS)
+    {
+        copy_fb_to_mxarray(image_buffer.ptr(), output_scale, dims[0], dims[1], dims[2], (float *) mxGetData(array));
+    }
+    else
+    {
+        copy_fb_to_mxarray(image_buffer.ptr(), output_scale, dims[0], dims[1], dims[2], (double *) mxGetData(array));
+    }
+    return array;
+}
+
+// Returns the results of a sweep as one H x W x C x N array, result i in
+// (:, :, :, i).
+mxArray *sweep_to_mxarray(const std::vector<ctl::dpx::fb<float> *> &images, float output_scale, mxClassID class_id)
+{
+    mwSize dims[4] = { 0, 0, 0, 0 };
+    mxArray *array;
+    
+    if (images.size() > 0)
+    {
+        dims[0] = images[0]->height();
+        dims[1] = images[0]->width();
+        dims[2] = images[0]->depth();
+        dims[3] = images.size();
+    }
+    array = mxCreateNumericArray(4, dims, class_id, mxREAL);
+    
+    size_t plane = dims[0] * dims[1] * dims[2];
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        if (class_id == mxSINGLE_CLASS)
+        {
+            copy_fb_to_mxarray(images[i]->ptr(), output_scale, dims[0], dims[1], dims[2], (float *) mxGetData(array) + i * plane);
+        }
+        else
+        {
+            copy_fb_to_mxarray(images[i]->ptr(), output_scale, dims[0], dims[1], dims[2], (double *) mxGetData(array) + i * plane);
+        }
+    }
+    return array;
+}
+
+// The result of an in memory job: its image, or every image of a sweep.
+mxArray *job_image(Job *job, mxClassID class_id)
+{
+    if (job->sweeping())
+    {
+        return sweep_to_mxarray(job->sweep_images(), job->output_scale(), class_id);
+    }
+    return fb_to_mxarray(*job->image(), job->output_scale(), class_id);
+}
+
+// Function declarations.
+void usagePrompt(const char*);
+
+void report_lut_error(const Lut3D *lut)
+{
+    if (lut != NULL && verbosity > 0 && lut->error_samples() > 0)
+    {
+        mexPrintf("3D LUT maximum interpolation error: %g (%d pixels of the first frame checked)\n",
+                  lut->max_error(), (int) lut->error_samples());
+    }
+}
+
+// Jobs started with -async, by the id handed back to MATLAB. The class of
+// an in memory job's input array is kept for its result.
+struct async_job_t
+{
+    Job *job;
+    mxClassID class_id;
+    int prepared;
+};
+typedef std::map<int, async_job_t> AsyncJobs;
+
+static AsyncJobs async_jobs;
+static int next_job_id = 1;
+
+// Pipelines checked once by -prepare and run by -apply, by the id handed
+// back to MATLAB, from the same ids as the jobs. A pipeline holds copies
+// of its strings and the lut baked from them, which the jobs applying it
+// share.
+struct prepared_t
+{
+    prepared_t(const Compression &compression) : compression(compression) {}
+
+    const char *keep(const char *s)
+    {
+        strings.push_back(s);
+        return strings.back().c_str();
+    }
+
+    std::list<std::string> strings;
+    CTLOperations ctl_operations;
+    CTLParameters global_ctl_parameters;
+    float input_scale;
+    float output_scale;
+    Compression compression;
+    format_t desired_format;
+    bool force_overwrite_output_file;
+    bool noalpha;
+    bool async;
+    int threads;
+    transform_options_t options;
+    int frames_in_flight;
+    int read_ahead;
+    RenderCache *cache;
+    region_t region;
+    int lut_size;
+    Lut3D::shaper_t lut_shaper;
+    float lut_range[2];
+    std::auto_ptr<Lut3D> lut;
+};
+typedef std::map<int, prepared_t *> PreparedPipelines;
+
+static PreparedPipelines prepared_pipelines;
+
+// Frees the strings mexFunction made of its arguments however it returns.
+// Nothing a call leaves behind points at them: jobs and prepared
+// pipelines keep copies.
+class ArgStrings
+{
+    public:
+        ArgStrings(int argc, const char **argv) : _argc(argc), _argv(argv) {}
+        ~ArgStrings()
+        {
+            for (int j = 0; j < _argc; j++)
+            {
+                mxFree((void *) _argv[j]);
+            }
+            mxFree((void *) _argv);
+        }
+
+    private:
+        int _argc;
+        const char **_argv;
+};
+
+// Thread budget used when a call does not give -threads, set with
+// -default_threads. 0 is one thread per processor.
+static int session_threads = 0;
+
+// Render caches opened with -cache, by directory. Jobs may still be using
+// one, so they are only closed on exit.
+typedef std::map<std::string, RenderCache *> RenderCaches;
+
+static RenderCaches render_caches;
+
+RenderCache *open_render_cache(const char *directory, double max_megabytes)
+{
+    RenderCaches::iterator i = render_caches.find(directory);
+    RenderCache *cache;
+    
+    if (i != render_caches.end())
+    {
+        cache = i->second;
+        if (max_megabytes > 0.0)
+        {
+            cache->set_max_bytes(max_megabytes * 1e6);
+        }
+        return cache;
+    }
+    // 4 GB unless told otherwise.
+    cache = new RenderCache(directory, max_megabytes > 0.0 ? max_megabytes * 1e6 : 4e9);
+    render_caches[directory] = cache;
+    return cache;
+}
+
+mxArray *cache_stats_to_mxarray(RenderCache *cache)
+{
+    static const char *fields[] = { "directory", "hits", "misses", "stores", "evictions",
+                                    "entries", "bytes", "max_bytes" };
+    mxArray *stats = mxCreateStructMatrix(1, 1, sizeof(fields) / sizeof(fields[0]), fields);
+    
+    mxSetField(stats, 0, "directory", mxCreateString(cache->directory().c_str()));
+    mxSetField(stats, 0, "hits", mxCreateDoubleScalar(cache->hits()));
+    mxSetField(stats, 0, "misses", mxCreateDoubleScalar(cache->misses()));
+    mxSetField(stats, 0, "stores", mxCreateDoubleScalar(cache->stores()));
+    mxSetField(stats, 0, "evictions", mxCreateDoubleScalar(cache->evictions()));
+    mxSetField(stats, 0, "entries", mxCreateDoubleScalar(cache->entries()));
+    mxSetField(stats, 0, "bytes", mxCreateDoubleScalar(cache->bytes()));
+    mxSetField(stats, 0, "max_bytes", mxCreateDoubleScalar(cache->max_bytes()));
+    return stats;
+}
+
+bool is_job_command(const char *arg)
+{
+    return !strcmp(arg, "-status") || !strcmp(arg, "-wait") ||
+           !strcmp(arg, "-cancel") || !strcmp(arg, "-release");
+}
+
+const char *job_state_name(Job::state_t state)
+{
+    switch (state)
+    {
+        case Job::RUNNING:   return "running";
+        case Job::DONE:      return "done";
+        case Job::FAILED:    return "failed";
+        case Job::CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+mxArray *job_outputs(Job *job)
+{
+    std::vector<std::string> outputs = job->outputs();
+    mxArray *cell = mxCreateCellMatrix(outputs.size(), 1);
+    
+    for (size_t i = 0; i < outputs.size(); i++)
+    {
+        mxSetCell(cell, i, mxCreateString(outputs[i].c_str()));
+    }
+    return cell;
+}
+
+mxArray *seconds_to_mxarray(const std::vector<double> &seconds)
+{
+    mxArray *array = mxCreateDoubleMatrix(1, seconds.size(), mxREAL);
+    
+    for (size_t i = 0; i < seconds.size(); i++)
+    {
+        mxGetPr(array)[i] = seconds[i];
+    }
+    return array;
+}
+
+// Fills element i of a struct array created with the stats_fields below.
+void set_stats_fields(mxArray *array, mwIndex i, const transform_stats_t &stats)
+{
+    mxSetField(array, i, "pixels", mxCreateDoubleScalar(stats.pixels));
+    mxSetField(array, i, "read", mxCreateDoubleScalar(stats.read));
+    mxSetField(array, i, "mkresult", mxCreateDoubleScalar(stats.mkresult));
+    mxSetField(array, i, "operations", seconds_to_mxarray(stats.operations));
+    mxSetField(array, i, "lut", mxCreateDoubleScalar(stats.lut));
+    mxSetField(array, i, "mkimage", mxCreateDoubleScalar(stats.mkimage));
+    mxSetField(array, i, "write", mxCreateDoubleScalar(stats.write));
+    mxSetField(array, i, "total", mxCreateDoubleScalar(stats.total));
+    mxSetField(array, i, "bytes_read", mxCreateDoubleScalar(stats.bytes_read));
+    mxSetField(array, i, "bytes_written", mxCreateDoubleScalar(stats.bytes_written));
+}
+
+// Returns the timings of a job as a struct with a 'frames' struct array,
+// one element per frame in the order they finished, and their sum in
+// 'total' along with the elapsed time and throughput of the whole job.
+mxArray *stats_to_mxarray(const std::vector<transform_stats_t> &frames, double elapsed)
+{
+    static const char *fields[] = { "frames", "total" };
+    static const char *frame_fields[] = { "input", "output", "pixels", "read", "mkresult", "operations", "lut",
+                                          "mkimage", "write", "total", "bytes_read", "bytes_written", "cached" };
+    static const char *total_fields[] = { "frames", "elapsed", "pixels", "read", "mkresult", "operations", "lut",
+                                          "mkimage", "write", "total", "bytes_read", "bytes_written",
+                                          "mpix_per_s", "read_mb_per_s", "write_mb_per_s", "cache_hits" };
+    mxArray *stats = mxCreateStructMatrix(1, 1, sizeof(fields) / sizeof(fields[0]), fields);
+    mxArray *frame_array = mxCreateStructMatrix(1, frames.size(), sizeof(frame_fields) / sizeof(frame_fields[0]), frame_fields);
+    mxArray *total_array = mxCreateStructMatrix(1, 1, sizeof(total_fields) / sizeof(total_fields[0]), total_fields);
+    transform_stats_t total;
+    size_t cache_hits = 0;
+    
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const transform_stats_t &frame = frames[i];
+        
+        mxSetField(frame_array, i, "input", mxCreateString(frame.input.c_str()));
+        mxSetField(frame_array, i, "output", mxCreateString(frame.output.c_str()));
+        set_stats_fields(frame_array, i, frame);
+        mxSetField(frame_array, i, "cached", mxCreateLogicalScalar(frame.cached));
+        cache_hits += frame.cached ? 1 : 0;
+        
+        total.pixels += frame.pixels;
+        total.read += frame.read;
+        total.mkresult += frame.mkresult;
+        total.lut += frame.lut;
+        total.mkimage += frame.mkimage;
+        total.write += frame.write;
+        total.total += frame.total;
+        total.bytes_read += frame.bytes_read;
+        total.bytes_written += frame.bytes_written;
+        total.operations.resize(std::max(total.operations.size(), frame.operations.size()), 0.0);
+        for (size_t k = 0; k < frame.operations.size(); k++)
+        {
+            total.operations[k] += frame.operations[k];
+        }
+    }
+    
+    mxSetField(total_array, 0, "frames", mxCreateDoubleScalar(frames.size()));
+    mxSetField(total_array, 0, "elapsed", mxCreateDoubleScalar(elapsed));
+    set_stats_fields(total_array, 0, total);
+    mxSetField(total_array, 0, "mpix_per_s", mxCreateDoubleScalar(elapsed > 0.0 ? total.pixels / elapsed / 1e6 : 0.0));
+    mxSetField(total_array, 0, "read_mb_per_s", mxCreateDoubleScalar(total.read > 0.0 ? total.bytes_read / total.read / 1e6 : 0.0));
+    mxSetField(total_array, 0, "cache_hits", mxCreateDoubleScalar(cache_hits));
+    mxSetField(total_array, 0, "write_mb_per_s", mxCreateDoubleScalar(total.write > 0.0 ? total.bytes_written / total.write / 1e6 : 0.0));
+    
+    mxSetField(stats, 0, "frames", frame_array);
+    mxSetField(stats, 0, "total", total_array);
+    return stats;
+}
+
+mxArray *job_status(Job *job)
+{
+    static const char *fields[] = { "state", "frames_done", "frames_total", "elapsed",
+                                    "frames_per_second", "outputs", "error" };
+    mxArray *status = mxCreateStructMatrix(1, 1, sizeof(fields) / sizeof(fields[0]), fields);
+    size_t done = job->frames_done();
+    double elapsed = job->elapsed();
+    
+    mxSetField(status, 0, "state", mxCreateString(job_state_name(job->state())));
+    mxSetField(status, 0, "frames_done", mxCreateDoubleScalar(done));
+    mxSetField(status, 0, "frames_total", mxCreateDoubleScalar(job->frames_total()));
+    mxSetField(status, 0, "elapsed", mxCreateDoubleScalar(elapsed));
+    mxSetField(status, 0, "frames_per_second", mxCreateDoubleScalar(elapsed > 0.0 ? done / elapsed : 0.0));
+    mxSetField(status, 0, "outputs", job_outputs(job));
+    mxSetField(status, 0, "error", mxCreateString(job->error().c_str()));
+    return status;
+}
+
+// -status, -wait, -cancel and -release take the id -async returned, either
+// as a number or as a string.
+void job_command(int nlhs, mxArray *plhs[], int argc, const char **argv, const mxArray *input_array)
+{
+    int id;
+    
+    if (input_array != NULL && mxGetNumberOfElements(input_array) == 1)
+    {
+        id = (int) mxGetScalar(input_array);
+    }
+    else if (argc > 1)
+    {
+        id = atoi(argv[1]);
+    }
+    else
+    {
+        mexPrintf("the %s option requires a job returned by -async.\n", argv[0]);
+        return;
+    }
+    
+    AsyncJobs::iterator i = async_jobs.find(id);
+    if (i == async_jobs.end())
+    {
+        PreparedPipelines::iterator p = prepared_pipelines.find(id);
+        if (!strcmp(argv[0], "-release") && p != prepared_pipelines.end())
+        {
+            // Its jobs use its strings and lut until they are released.
+            for (i = async_jobs.begin(); i != async_jobs.end(); i++)
+            {
+                if (i->second.prepared == id)
+                {
+                    mexPrintf("Pipeline %d is still used by job %d, release that first.\n", id, i->first);
+                    return;
+                }
+            }
+            delete p->second;
+            prepared_pipelines.erase(p);
+            return;
+        }
+        mexPrintf("There is no job %d, it may have been released already.\n", id);
+        return;
+    }
+    Job *job = i->second.job;
+    
+    if (!strcmp(argv[0], "-status"))
+    {
+        plhs[0] = job_status(job);
+    }
+    else if (!strcmp(argv[0], "-wait"))
+    {
+        job->wait();
+        if (job->state() == Job::FAILED)
+        {
+            mexPrintf("exception thrown (oops...): %s\n", job->error().c_str());
+            return;
+        }
+        report_lut_error(job->lut());
+        if (job->in_memory())
+        {
+            plhs[0] = job_image(job, i->second.class_id);
+        }
+        else
+        {
+            plhs[0] = job_outputs(job);
+        }
+        if (nlhs > 1)
+        {
+            plhs[1] = stats_to_mxarray(job->stats(), job->elapsed());
+        }
+    }
+    else if (!strcmp(argv[0], "-cancel"))
+    {
+        job->cancel();
+    }
+    else
+    {
+        // Waits for the frames already started.
+        delete job;
+        async_jobs.erase(i);
+    }
+}
+
+// Called by MATLAB on 'clear mex' or when it exits.
+void mexExit()
+{
+    for (AsyncJobs::iterator i = async_jobs.begin(); i != async_jobs.end(); i++)
+    {
+        delete i->second.job;
+    }
+    async_jobs.clear();
+    for (PreparedPipelines::iterator i = prepared_pipelines.begin(); i != prepared_pipelines.end(); i++)
+    {
+        delete i->second;
+    }
+    prepared_pipelines.clear();
+    for (RenderCaches::iterator i = render_caches.begin(); i != render_caches.end(); i++)
+    {
+        delete i->second;
+    }
+    render_caches.clear();
+    buffer_pool().release_idle();
+    flush_ctl_module_cache();
+    release_ctl_thread_pool();
+}
+
+
+// Names the destination of every source file and queues it on job,
+// refusing the same things ctlrender does. Source files found in sequences
+// stand for every frame of that sequence. Returns false when nothing
+// should be run at all.
+bool queue_frames(Job *job, std::list<const char *> &input_image_files, const std::map<const char *, sequence_t> &sequences,
+                  const format_t &desired_format, bool force_overwrite_output_file, bool noalpha)
+{
+	char output_path[MAXPATHLEN + 1];
+	format_t actual_format;
+    
+	if (input_image_files.size() < 2)
+	{
+		mexPrintf(
+				"one or more source filenames and a destination "
+				"file or directory must be\nprovided. if more than one "
+				"source filenames is provided then the last argument\nmust "
+				"be a directory. see -help for more details.\n");
+		return false;
+	}
+    
+	char *output_slash = NULL;
+	const char *outputFile = input_image_files.back();
+	input_image_files.pop_back();
+
+	// A file or directory of that name is taken as it is.
+	sequence_t output_sequence;
+	if (access(outputFile, F_OK) < 0 && parse_sequence_pattern(outputFile, &output_sequence))
+	{
+		mexPrintf(
+				"the destination %s names numbered frames, which only "
+				"-sweep writes. Frames\nof a sequence keep their own names "
+				"in a destination directory.\n", outputFile);
+		return false;
+	}
+
+	size_t source_frames = 0;
+	for (std::list<const char *>::const_iterator f = input_image_files.begin(); f != input_image_files.end(); f++)
+	{
+		std::map<const char *, sequence_t>::const_iterator sequence = sequences.find(*f);
+		source_frames += sequence != sequences.end() ? sequence_length(sequence->second) : 1;
+	}
+    
+	struct stat file_status;
+	if (stat(outputFile, &file_status) >= 0)
+	{
+		if (S_ISDIR(file_status.st_mode))
+		{
+			memset(output_path, 0, sizeof(output_path));
+			strncpy(output_path, outputFile, MAXPATHLEN);
+			outputFile = output_path;
+			output_slash = output_path + strlen(output_path);
+			if (*output_slash != '/')
+			{
+				*(output_slash++) = '/';
+				*output_slash = 0;
+			}
+		}
+		else if (S_ISREG(file_status.st_mode))
+		{
+			if (source_frames > 1)
+			{
+				mexPrintf(
+						"When providing more than one source "
+						"image the destination must be a\ndirectory.\n");
+				return false;
+			}
+			else
+			{
+				if (!force_overwrite_output_file)
+				{
+					mexPrintf(
+							"The destination file %s already exists.\n"
+							"Cravenly refusing to overwrite unless you supply "
+							"the -force option.\n", outputFile);
+					return false;
+				}
+				else
+				{
+					// File exists, but we treat it as if it doesn't (see
+					// if(output_slash==NULL) {...} down below...
+					output_slash = NULL;
+				}
+			}
+		}
+		else
+		{
+			mexPrintf(
+					"Specified destination is something other than "
+					"a file or directory. That's\nprobably a bad idea.\n");
+			return false;
+		}
+	}
+	else
+	{
+		if (errno != ENOENT)
+		{
+			mexPrintf("Unable to get information about %s (%s).\n", outputFile, strerror(errno));
+			return false;
+		}
+		if (source_frames != 1)
+		{
+			mexPrintf(
+					"When specifying more than one source file "
+					"you must specify the destination as\na directory "
+					"that already exists.\nUnable to stat '%s' (%s)\n",
+					outputFile, strerror(errno));
+			return false;
+		}
+	}
+    
+	if (output_slash == NULL)
+	{
+		// This is the case when our outputFile is a single file. We do a bunch
+		// of sanity checking between the extension of the specified file
+		// (if any) and the -format option (if any).
+		char *dot = (char *) strrchr(outputFile, '.');
+		if (dot == NULL && desired_format.ext == NULL)
+		{
+			mexPrintf(
+					"You have not explicitly provided an output "
+					"format, and the output file name\ndoes not not contain "
+					"an extension. Please add an extension to the output "
+					"file\nor use the -format option to specify the desired "
+					"output format.\n");
+			return false;
+		}
+		else if (dot != NULL)
+		{
+			if (desired_format.ext == NULL)
+			{
+				actual_format = find_format(dot + 1,
+						                    " specified implicitly (by "
+								            "the extension) for\noutput file "
+								            "format. Please fix this or use\n"
+								            "the -format option to specify "
+								            "the desired output format.\n");
+			}
+			else
+			{
+				// HACK aces format file type check
+                const char *ext = desired_format.ext;
+                static const char exrext[] = "exr";
+                if (!strcmp(ext, "aces"))
+                    ext = exrext;
+                    if (strcmp(ext, dot + 1) && !force_overwrite_output_file)
+                    {
+                        mexPrintf(
+                                "You have specified a destination file "
+                                "type with the -format option, but the\noutput "
+                                "file extension does not match the format "
+                                "specified by the -format option.\nCravenly "
+                                "refusing to do this unless you specify the "
+                                "-force option (which\nwill make the -format "
+                                "option take priority).\n");
+                        return false;
+                    }
+				actual_format = desired_format;
+			}
+		}
+	}
+    
+	// The job names and checks each frame when it gets to it, as ctlrender
+	// would have once the frames before it were written. Only the format
+	// is found here, from the extension a frame's destination will have.
+	job->set_overwrite(force_overwrite_output_file);
+	for (; input_image_files.size() > 0; input_image_files.pop_front())
+	{
+		std::map<const char *, sequence_t>::const_iterator sequence = sequences.find(input_image_files.front());
+		std::string input_name = sequence != sequences.end() ? sequence_file(sequence->second, 0) : input_image_files.front();
+		const char *inputFile = input_name.c_str();
+        
+		if (output_slash == NULL)
+		{
+			actual_format.squish = noalpha;
+			job->add_frame(inputFile, outputFile, actual_format);
+			continue;
+		}
+
+		const char *extension = NULL;
+		const char *input_slash = strrchr(inputFile, '/');
+		const char *dot = strrchr(input_slash != NULL ? input_slash : inputFile, '.');
+		if (desired_format.ext != NULL)
+		{
+			// HACK aces format file type check
+			extension = desired_format.ext;
+			static const char exrext[] = "exr";
+			if (!strcmp(extension, "aces"))
+				extension = exrext;
+			actual_format = desired_format;
+		}
+		else if (dot != NULL)
+		{
+			actual_format = find_format(dot + 1, " (determined from destination file extension).");
+		}
+		actual_format.squish = noalpha;
+		job->add_frames(input_image_files.front(), sequence != sequences.end() ? &sequence->second : NULL,
+		                output_path, extension, actual_format);
+	}
+	return true;
+}
+
+// Sets job up to sweep the parameter name over values, on either
+// input_array or a single source file. With a destination, which must
+// name numbered frames, the result for values[i] is written to frame i + 1,
+// refusing what queue_frames refuses. Without one the results are kept in
+// memory. Returns false when nothing should be run at all.
+bool queue_sweep(Job *job, bool have_array, std::list<const char *> &input_image_files, const std::map<const char *, sequence_t> &sequences,
+                 const char *name, const std::vector<float> &values, const format_t &desired_format, bool force_overwrite_output_file, bool noalpha)
+{
+	const char *inputFile = NULL;
+	const char *outputFile = NULL;
+	format_t actual_format;
+
+	if (!have_array && input_image_files.size() > 0)
+	{
+		inputFile = input_image_files.front();
+		input_image_files.pop_front();
+	}
+	if (input_image_files.size() > 0)
+	{
+		outputFile = input_image_files.front();
+		input_image_files.pop_front();
+	}
+	if ((!have_array && inputFile == NULL) || input_image_files.size() > 0 || !sequences.empty())
+	{
+		mexPrintf(
+				"-sweep takes a single source file or image array, and "
+				"optionally a\ndestination naming numbered frames. see "
+				"-help sweep for more details.\n");
+		return false;
+	}
+
+	std::vector<std::string> outputs;
+	actual_format.squish = noalpha;
+	if (outputFile != NULL)
+	{
+		sequence_t sequence;
+		frame_range_t range;
+
+		if (!parse_sequence_pattern(outputFile, &sequence))
+		{
+			mexPrintf(
+					"the -sweep destination %s must hold a frame number, "
+					"such as out.%%04d.exr.\nsee -help sweep for more "
+					"details.\n", outputFile);
+			return false;
+		}
+		const char *dot = strrchr(sequence.suffix.c_str(), '.');
+		if (desired_format.ext != NULL)
+		{
+			actual_format = desired_format;
+		}
+		else if (dot != NULL)
+		{
+			actual_format = find_format(dot + 1, " (determined from destination file extension).");
+		}
+		else
+		{
+			mexPrintf(
+					"You have not explicitly provided an output "
+					"format, and the output file name\ndoes not not contain "
+					"an extension. Please add an extension to the output "
+					"file\nor use the -format option to specify the desired "
+					"output format.\n");
+			return false;
+		}
+		actual_format.squish = noalpha;
+
+		range.first = 1;
+		range.last = values.size();
+		range.step = 1;
+		sequence.ranges.push_back(range);
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			std::string output = sequence_file(sequence, i);
+			if (force_overwrite_output_file && unlink(output.c_str()) < 0 && errno != ENOENT)
+			{
+				mexPrintf("Unable to remove existing file named "
+						"'%s' (%s).\n", output.c_str(), strerror(errno));
+				return false;
+			}
+			if (access(output.c_str(), F_OK) >= 0)
+			{
+				mexPrintf("Cravenly refusing to overwrite the file '%s'.\n", output.c_str());
+				return false;
+			}
+			outputs.push_back(output);
+		}
+	}
+
+	job->set_image(inputFile, actual_format);
+	job->set_sweep(name, values, outputs, actual_format);
+	return true;
+}
+
+// Adds the source file argv[0] to input_image_files, with the frames in
+// argv[1] when it is a sequence pattern. A name that holds '#' or %d but is
+// that of a file that exists is the file. Returns the number of arguments
+// taken, 0 when the frames are missing.
+int add_source(int argc, const char **argv, std::list<const char *> *input_image_files, std::map<const char *, sequence_t> *sequences)
+{
+	sequence_t sequence;
+
+	// The last argument is a destination, -sweep numbers its results with
+	// a pattern.
+	if (argc > 1 && access(argv[0], F_OK) < 0 && parse_sequence_pattern(argv[0], &sequence))
+	{
+		if (!parse_frame_ranges(argv[1], &sequence))
+		{
+			mexPrintf(
+					"the sequence %s must be followed by its "
+					"frames, such as 1001-1100 or\n1001-1100x2. "
+					"See '-help sequence' for more details.\n", argv[0]);
+			return 0;
+		}
+		(*sequences)[argv[0]] = sequence;
+		input_image_files->push_back(argv[0]);
+		return 2;
+	}
+	input_image_files->push_back(argv[0]);
+	return 1;
+}
+
+// Sets job up to transform input_array, or a single source file for
+// MATLAB, in memory, and otherwise to transform the files into their
+// destination.
+bool queue_transform(Job *job, int nlhs, const mxArray *input_array, float input_scale, const region_t &region, bool noalpha,
+                     std::list<const char *> &input_image_files, const std::map<const char *, sequence_t> &sequences,
+                     const format_t &desired_format, bool force_overwrite_output_file)
+{
+	if (input_array != NULL || (nlhs > 0 && input_image_files.size() == 1 && sequences.empty()))
+	{
+		// In memory transform, the result goes back to MATLAB rather
+		// than to a destination file.
+		format_t image_format;
+
+		if (input_array != NULL && input_image_files.size() > 0)
+		{
+			mexPrintf(
+					"source and destination filenames may not be "
+					"given together with an input\nimage array. see "
+					"-help for more details.\n");
+			return false;
+		}
+
+		image_format.squish = noalpha;
+		if (input_array != NULL)
+		{
+			mxarray_to_fb(input_array, input_scale, region, job->image());
+			job->set_image(NULL, image_format);
+		}
+		else
+		{
+			job->set_image(input_image_files.front(), image_format);
+		}
+		return true;
+	}
+
+	if (!region.whole())
+	{
+		mexPrintf(
+				"-roi and -preview_step apply to results returned to "
+				"MATLAB, not to\nframes written to destination files. "
+				"See '-help preview' for more details.\n");
+		return false;
+	}
+	return queue_frames(job, input_image_files, sequences, desired_format, force_overwrite_output_file, noalpha);
+}
+
+// Runs job and hands its result back, or with async starts it and hands
+// back its id. prepared is the -prepare pipeline the job was made from, 0
+// for none.
+void run_call_job(int nlhs, mxArray *plhs[], std::auto_ptr<Job> &job, const mxArray *input_array, bool async, int threads, int frames_in_flight, int prepared)
+{
+	// A sweep evaluates and writes its results one after the other.
+	transform_options_t options = job->options();
+	options.threads = set_thread_budget(threads, frames_in_flight > 1 && job->frames_total() > 1 && !job->sweeping());
+	job->set_options(options);
+
+	mxClassID class_id = input_array != NULL ? mxGetClassID(input_array) : mxSINGLE_CLASS;
+	if (async)
+	{
+		async_job_t async_job;
+		async_job.job = job.get();
+		async_job.class_id = class_id;
+		async_job.prepared = prepared;
+		job->start();
+		async_jobs[next_job_id] = async_job;
+		job.release();
+		plhs[0] = mxCreateDoubleScalar(next_job_id++);
+		return;
+	}
+
+	job->run();
+	if (job->state() == Job::FAILED)
+	{
+		THROW(Iex::BaseExc, job->error());
+	}
+	// The timings are the last output: after the image of an in memory
+	// transform, or on their own.
+	if (job->in_memory())
+	{
+		plhs[0] = job_image(job.get(), class_id);
+		if (nlhs > 1)
+		{
+			plhs[1] = stats_to_mxarray(job->stats(), job->elapsed());
+		}
+	}
+	else if (nlhs > 0)
+	{
+		plhs[0] = stats_to_mxarray(job->stats(), job->elapsed());
+	}
+	report_lut_error(job->lut());
+}
+
+// -apply runs a pipeline made by -prepare on the image array, or the
+// source files and destination, that follow its id. Nothing but the
+// sources is parsed or checked again.
+void apply_command(int nlhs, mxArray *plhs[], int argc, const char **argv, const mxArray *input_array, const mxArray *handle_array)
+{
+	std::list<const char *> input_image_files;
+	std::map<const char *, sequence_t> sequences;
+	int id;
+
+	argv++;
+	argc--;
+	if (handle_array != NULL)
 	{
-		if (!strcmp(current->name, fmt))
+		id = (int) mxGetScalar(handle_array);
+	}
+	else if (argc > 0)
+	{
+		id = atoi(argv[0]);
+		argv++;
+		argc--;
+	}
+	else
+	{
+		mexPrintf("the -apply option requires a pipeline returned by -prepare.\n");
+		return;
+	}
+
+	PreparedPipelines::iterator i = prepared_pipelines.find(id);
+	if (i == prepared_pipelines.end())
+	{
+		mexPrintf("There is no pipeline %d, it may have been released already.\n", id);
+		return;
+	}
+	prepared_t *pipeline = i->second;
+
+	while (argc > 0)
+	{
+		int taken = add_source(argc, argv, &input_image_files, &sequences);
+		if (taken == 0)
 		{
-			return current->output_fmt;
+			return;
 		}
-		current++;
+		argv += taken;
+		argc -= taken;
+	}
+	if (input_array == NULL && input_image_files.empty())
+	{
+		mexPrintf("-apply requires an image array or source files. See '-help prepare'\nfor more details.\n");
+		return;
 	}
-	mexPrintf("Unrecognized format '%s'%s", fmt, message ? message : ".");
-    mexErrMsgTxt("Throwing error\n");
-    // Error should be thrown before reaching here.
-	return current->output_fmt;
-}
-
-int verbosity = 1;
 
-// Function declarations.
-void usagePrompt(const char*);
+	try
+	{
+		std::auto_ptr<Job> job(new Job(pipeline->input_scale, pipeline->output_scale, pipeline->compression,
+		                               pipeline->ctl_operations, pipeline->global_ctl_parameters,
+		                               pipeline->frames_in_flight, pipeline->read_ahead));
 
+		job->set_options(pipeline->options);
+		job->set_cache(pipeline->cache);
+		job->set_region(pipeline->region);
+		if (pipeline->lut_size > 0)
+		{
+			job->set_lut(pipeline->lut_size, pipeline->lut_shaper, pipeline->lut_range[0], pipeline->lut_range[1], pipeline->lut.get());
+		}
+		if (!queue_transform(job.get(), nlhs, input_array, pipeline->input_scale, pipeline->region, pipeline->noalpha,
+		                     input_image_files, sequences, pipeline->desired_format, pipeline->force_overwrite_output_file))
+		{
+			return;
+		}
+		run_call_job(nlhs, plhs, job, input_array, pipeline->async, pipeline->threads, pipeline->frames_in_flight, id);
+	}
+	catch (std::exception &e)
+	{
+		mexPrintf("exception thrown (oops...): %s\n", e.what());
+	}
+}
 
 // Function definitions.
 // -----------------------------------------------------------------
@@ -142,11 +1185,31 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     mwIndex i;
     int k, ncell;
     int j = 0;
+    const mxArray *input_array = NULL;
+    const mxArray *handle_array = NULL;
+    char first[8];
+    static bool registered_exit = FALSE;
+    
+    if( !registered_exit )
+    {
+        mexAtExit( mexExit );
+        registered_exit = TRUE;
+    }
     
-    // Count inputs and check for char type
+    // Count inputs and check for char type. A single or double array is
+    // an image to transform in memory and is not part of argv, except for
+    // the pipeline id that follows -apply.
+    
+    if( nrhs > 1 && mxIsChar( prhs[0] ) && mxGetString( prhs[0], first, sizeof(first) ) == 0 &&
+        !strcmp( first, "-apply" ) && !mxIsChar( prhs[1] ) && mxGetNumberOfElements( prhs[1] ) == 1 )
+    {
+        handle_array = prhs[1];
+    }
     
     for( k=0; k<nrhs; k++ )
     {
+        if( prhs[k] == handle_array )
+            continue;
         if( mxIsCell( prhs[k] ) )
         {
             argc += ncell = mxGetNumberOfElements( prhs[k] );
@@ -154,6 +1217,14 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
                 if( !mxIsChar( mxGetCell( prhs[k], i ) ) )
                     mexErrMsgTxt("Input cell element is not char");
         }
+        else if( mxIsSingle( prhs[k] ) || mxIsDouble( prhs[k] ) )
+        {
+            if( input_array != NULL )
+                mexErrMsgTxt("Only one input image array may be given");
+            if( mxIsComplex( prhs[k] ) )
+                mexErrMsgTxt("Input image array must be real");
+            input_array = prhs[k];
+        }
         else
         {
             argc++;
@@ -174,11 +1245,12 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
                 argv[j++] = mxArrayToString( mxGetCell( prhs[k], i )
                                             );
         }
-        else
+        else if( prhs[k] != input_array && prhs[k] != handle_array )
         {
             argv[j++] = mxArrayToString( prhs[k] );
         }
     }
+    ArgStrings strings( argc, argv );
     
     /*
     for(j = 0; j < argc; j++) {
@@ -186,6 +1258,17 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     }
     */
     
+    if( argc > 0 && is_job_command( argv[0] ) )
+    {
+        job_command( nlhs, plhs, argc, argv, input_array );
+        return;
+    }
+    if( argc > 0 && !strcmp( argv[0], "-apply" ) )
+    {
+        apply_command( nlhs, plhs, argc, argv, input_array, handle_array );
+        return;
+    }
+    
     
 	try
 	{  
@@ -197,15 +1280,35 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         
 		// list of input images on which to operate
 		std::list<const char *> input_image_files;
-		char output_path[MAXPATHLEN + 1];
+		std::map<const char *, sequence_t> sequences;
         
         Compression compression = Compression::compressionNamed("PIZ");
 		format_t desired_format;
-		format_t actual_format;
 		float input_scale = 0.0;
 		float output_scale = 0.0;
 		bool force_overwrite_output_file = FALSE;
 		bool noalpha = FALSE;
+		bool flushed_cache = FALSE;
+		bool pool_changed = FALSE;
+		bool prepare = FALSE;
+		bool async = FALSE;
+		int threads = session_threads;
+		bool set_default_threads = FALSE;
+		transform_options_t options;
+		int frames_in_flight = 3;
+		int read_ahead = 2;
+		const char *sweep_name = NULL;
+		const char *cache_directory = NULL;
+		double cache_megabytes = 0.0;
+		bool cache_stats = FALSE;
+		RenderCache *cache = NULL;
+		std::vector<float> sweep_values;
+		region_t region;
+		int lut_size = 0;
+		Lut3D::shaper_t lut_shaper = Lut3D::LINEAR;
+		float lut_range[2] = { 0.0, 1.0 };
+		bool lut_range_given = FALSE;
+		std::auto_ptr<Job> job;
         
 		int start_argc = argc;
         
@@ -349,97 +1452,446 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 							"\nSee '-help param' for more details.\n");
 					return;
 				}
-				if (new_ctl_operation.filename == NULL)
+				if (new_ctl_operation.filename == NULL)
+				{
+					THROW(Iex::ArgExc, "the -param1 argument must occur *after* a -ctl option.");
+				}
+				new_ctl_operation.local.push_back(get_ctl_parameter(&argv, &argc, start_argc, "local", 1));
+			}
+			else if (!strcmp(argv[0], "-param2") || !strcmp(argv[0], "-p2"))
+			{
+				if (argc < 4)
+				{
+					mexPrintf(
+							"the -param2 option requires three additional "
+							"arguments specifying the\nparameter name and value."
+							"\nSee '-help param' for more details.\n");
+					return;
+                    
+				}
+				if (new_ctl_operation.filename == NULL)
+				{
+					THROW(Iex::ArgExc, "the -param2 argument must occur *after* a -ctl option.");
+				}
+				new_ctl_operation.local.push_back(get_ctl_parameter(&argv, &argc, start_argc, "local", 3));
+			}
+			else if (!strcmp(argv[0], "-param3") || !strcmp(argv[0], "-p3"))
+			{
+				if (argc < 5)
+				{
+					mexPrintf(
+							"the -param3 option requires four additional "
+							"arguments specifying the\nparameter name and value."
+							"\nSee '-help param' for more details.\n");
+					return;
+				}
+				if (new_ctl_operation.filename == NULL)
+				{
+					THROW(Iex::ArgExc, "the -param3 argument must occur *after* a -ctl option.");
+				}
+				new_ctl_operation.local.push_back(get_ctl_parameter(&argv, &argc, start_argc, "local", 3));
+			}
+			else if (!strcmp(argv[0], "-global_param1") || !strcmp(argv[0], "-gp1"))
+			{
+				if (argc < 3)
+				{
+					mexPrintf("the -global_param1 option requires two "
+							"additional arguments specifying the\nparameter "
+							"name and value.\nSee '-help param' for more "
+							"details.\n");
+					return;
+				}
+				global_ctl_parameters.push_back(get_ctl_parameter(&argv, &argc, start_argc, "global", 1));
+			}
+			else if (!strcmp(argv[0], "-global_param2") || !strcmp(argv[0], "-gp2"))
+			{
+				if (argc < 4)
+				{
+					mexPrintf("the -global_param2 option requires three "
+							"additional arguments specifying the\nparameter "
+							"name and value.\nSee '-help param' for more "
+							"details.\n");
+					return;
+				}
+				global_ctl_parameters.push_back(get_ctl_parameter(&argv, &argc, start_argc, "global", 2));
+			}
+			else if (!strcmp(argv[0], "-global_param3") || !strcmp(argv[0], "-gp3"))
+			{
+				if (argc < 5)
+				{
+					mexPrintf("the -global_param3 option requires four "
+							"additional arguments specifying the\nparameter "
+							"name and value.\nSee '-help param' for more "
+							"details.\n");
+					return;
+                    
+				}
+				global_ctl_parameters.push_back(get_ctl_parameter(&argv, &argc, start_argc, "global", 2));
+			}
+			else if (!strncmp(argv[0], "-verbose", 2))
+			{
+				verbosity++;
+			}
+			else if (!strncmp(argv[0], "-quiet", 2))
+			{
+				verbosity--;
+			}
+			else if (!strncmp(argv[0], "-force", 5))
+			{
+				force_overwrite_output_file = TRUE;
+			}
+			else if (!strncmp(argv[0], "-noalpha", 2))
+			{
+				noalpha = TRUE;
+			}
+			else if (!strcmp(argv[0], "-threads"))
+			{
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -threads option requires an additional "
+							"argument specifying the number\nof threads used "
+							"to evaluate the ctl scripts.\n");
+					return;
+				}
+				char *end = NULL;
+				threads = strtol(argv[1], &end, 10);
+				if ((end != NULL && *end != 0) || threads < 0)
+				{
+					mexPrintf(
+							"Unable to parse '%s' as a thread count for "
+							"the '-threads' argument\n", argv[1]);
+					return;
+				}
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-default_threads"))
+			{
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -default_threads option requires an "
+							"additional argument specifying the\nnumber of "
+							"threads used by later calls.\n");
+					return;
+				}
+				char *end = NULL;
+				session_threads = strtol(argv[1], &end, 10);
+				if ((end != NULL && *end != 0) || session_threads < 0)
+				{
+					mexPrintf(
+							"Unable to parse '%s' as a thread count for "
+							"the '-default_threads' argument\n", argv[1]);
+					session_threads = 0;
+					return;
+				}
+				threads = session_threads;
+				set_default_threads = TRUE;
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-inflight"))
+			{
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -inflight option requires an additional "
+							"argument specifying the number\nof frames "
+							"processed at the same time.\n");
+					return;
+				}
+				char *end = NULL;
+				frames_in_flight = strtol(argv[1], &end, 10);
+				if ((end != NULL && *end != 0) || frames_in_flight < 1)
+				{
+					mexPrintf(
+							"Unable to parse '%s' as a frame count for "
+							"the '-inflight' argument\n", argv[1]);
+					return;
+				}
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-read_ahead"))
+			{
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -read_ahead option requires an additional "
+							"argument specifying the number\nof frames "
+							"decoded ahead of the one being transformed.\n");
+					return;
+				}
+				char *end = NULL;
+				read_ahead = strtol(argv[1], &end, 10);
+				if ((end != NULL && *end != 0) || read_ahead < 0)
+				{
+					mexPrintf(
+							"Unable to parse '%s' as a frame count for "
+							"the '-read_ahead' argument\n", argv[1]);
+					return;
+				}
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-strip_rows"))
+			{
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -strip_rows option requires an additional "
+							"argument specifying the number\nof scanlines "
+							"transformed at a time.\n");
+					return;
+				}
+				char *end = NULL;
+				options.strip_rows = strtol(argv[1], &end, 10);
+				if ((end != NULL && *end != 0) || options.strip_rows < 0)
+				{
+					mexPrintf(
+							"Unable to parse '%s' as a scanline count for "
+							"the '-strip_rows' argument\n", argv[1]);
+					return;
+				}
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-sweep"))
+			{
+				if (argc < 3 || !parse_sweep_values(argv[2], &sweep_values))
+				{
+					mexPrintf(
+							"the -sweep option requires a parameter name and "
+							"the values it takes,\nas <start>:<step>:<stop> or "
+							"<start>:<stop>. See '-help sweep' for more\n"
+							"details.\n");
+					return;
+				}
+				sweep_name = argv[1];
+				argv += 2;
+				argc -= 2;
+			}
+			else if (!strcmp(argv[0], "-bake_lut"))
+			{
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -bake_lut option requires an additional "
+							"argument specifying the number\nof lattice points "
+							"per axis. See '-help lut' for more details.\n");
+					return;
+				}
+				char *end = NULL;
+				lut_size = strtol(argv[1], &end, 10);
+				if ((end != NULL && *end != 0) || lut_size < 2)
+				{
+					mexPrintf(
+							"Unable to parse '%s' as a lattice size (of at "
+							"least 2) for the '-bake_lut'\nargument\n", argv[1]);
+					return;
+				}
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-lut_shaper"))
+			{
+				if (argc == 1 || (strcmp(argv[1], "linear") && strcmp(argv[1], "log2")))
+				{
+					mexPrintf(
+							"the -lut_shaper option requires an additional "
+							"argument of either 'linear'\nor 'log2'. See "
+							"'-help lut' for more details.\n");
+					return;
+				}
+				lut_shaper = strcmp(argv[1], "log2") ? Lut3D::LINEAR : Lut3D::LOG2;
+				argv++;
+				argc--;
+			}
+			else if (!strcmp(argv[0], "-lut_range"))
+			{
+				if (argc < 3)
+				{
+					mexPrintf(
+							"the -lut_range option requires two additional "
+							"arguments specifying the\nlower and upper end of "
+							"the lattice. See '-help lut' for more details.\n");
+					return;
+				}
+				lut_range[0] = getfloat(argv[1], "lower end of the -lut_range");
+				lut_range[1] = getfloat(argv[2], "upper end of the -lut_range");
+				lut_range_given = TRUE;
+				argv += 2;
+				argc -= 2;
+			}
+			else if (!strcmp(argv[0], "-roi"))
+			{
+				long roi[4];
+				int i;
+				for (i = 0; i < 4 && i + 1 < argc; i++)
+				{
+					char *end = NULL;
+					roi[i] = strtol(argv[i + 1], &end, 10);
+					if ((end != NULL && *end != 0) || roi[i] < 1)
+					{
+						break;
+					}
+				}
+				if (i < 4)
 				{
-					THROW(Iex::ArgExc, "the -param1 argument must occur *after* a -ctl option.");
+					mexPrintf(
+							"the -roi option requires four additional positive "
+							"integers, the column\nand row of the upper left "
+							"pixel (from 1) and the width and height. See\n"
+							"'-help preview' for more details.\n");
+					return;
 				}
-				new_ctl_operation.local.push_back(get_ctl_parameter(&argv, &argc, start_argc, "local", 1));
+				region.x = roi[0] - 1;
+				region.y = roi[1] - 1;
+				region.width = roi[2];
+				region.height = roi[3];
+				argv += 4;
+				argc -= 4;
 			}
-			else if (!strcmp(argv[0], "-param2") || !strcmp(argv[0], "-p2"))
+			else if (!strcmp(argv[0], "-preview_step"))
 			{
-				if (argc < 4)
+				char *end = NULL;
+				long step = argc > 1 ? strtol(argv[1], &end, 10) : 0;
+				if (argc == 1 || (end != NULL && *end != 0) || step < 1)
 				{
 					mexPrintf(
-							"the -param2 option requires three additional "
-							"arguments specifying the\nparameter name and value."
-							"\nSee '-help param' for more details.\n");
+							"the -preview_step option requires an additional "
+							"argument, the positive\nspacing of the pixels kept "
+							"in each direction. See '-help preview' for more\n"
+							"details.\n");
 					return;
-                    
-				}
-				if (new_ctl_operation.filename == NULL)
-				{
-					THROW(Iex::ArgExc, "the -param2 argument must occur *after* a -ctl option.");
 				}
-				new_ctl_operation.local.push_back(get_ctl_parameter(&argv, &argc, start_argc, "local", 3));
+				region.step = step;
+				argv++;
+				argc--;
 			}
-			else if (!strcmp(argv[0], "-param3") || !strcmp(argv[0], "-p3"))
+			else if (!strcmp(argv[0], "-tile"))
 			{
-				if (argc < 5)
+				char *end = NULL;
+				bool valid = argc >= 3;
+				int tile_size[2] = { 0, 0 };
+				for (int i = 0; valid && i < 2; i++)
 				{
-					mexPrintf(
-							"the -param3 option requires four additional "
-							"arguments specifying the\nparameter name and value."
-							"\nSee '-help param' for more details.\n");
-					return;
+					tile_size[i] = strtol(argv[i + 1], &end, 10);
+					valid = (end == NULL || *end == 0) && tile_size[i] > 0;
 				}
-				if (new_ctl_operation.filename == NULL)
+				if (!valid)
 				{
-					THROW(Iex::ArgExc, "the -param3 argument must occur *after* a -ctl option.");
+					mexPrintf(
+							"the -tile option requires two additional "
+							"arguments, the positive width\nand height of "
+							"the tiles of exr output.\n");
+					return;
 				}
-				new_ctl_operation.local.push_back(get_ctl_parameter(&argv, &argc, start_argc, "local", 3));
+				options.tiling.width = tile_size[0];
+				options.tiling.height = tile_size[1];
+				argv += 2;
+				argc -= 2;
 			}
-			else if (!strcmp(argv[0], "-global_param1") || !strcmp(argv[0], "-gp1"))
+			else if (!strcmp(argv[0], "-tile_levels"))
 			{
-				if (argc < 3)
+				if (argc > 1 && !strcmp(argv[1], "one"))
 				{
-					mexPrintf("the -global_param1 option requires two "
-							"additional arguments specifying the\nparameter "
-							"name and value.\nSee '-help param' for more "
-							"details.\n");
+					options.tiling.levels = 0;
+				}
+				else if (argc > 1 && !strcmp(argv[1], "mipmap"))
+				{
+					options.tiling.levels = 1;
+				}
+				else if (argc > 1 && !strcmp(argv[1], "ripmap"))
+				{
+					options.tiling.levels = 2;
+				}
+				else
+				{
+					mexPrintf(
+							"the -tile_levels option requires an additional "
+							"argument, one of 'one',\n'mipmap' or 'ripmap'.\n");
 					return;
 				}
-				global_ctl_parameters.push_back(get_ctl_parameter(&argv, &argc, start_argc, "global", 1));
+				argv++;
+				argc--;
 			}
-			else if (!strcmp(argv[0], "-global_param2") || !strcmp(argv[0], "-gp2"))
+			else if (!strcmp(argv[0], "-async"))
 			{
-				if (argc < 4)
+				async = TRUE;
+			}
+			else if (!strcmp(argv[0], "-cache"))
+			{
+				if (argc == 1)
 				{
-					mexPrintf("the -global_param2 option requires three "
-							"additional arguments specifying the\nparameter "
-							"name and value.\nSee '-help param' for more "
-							"details.\n");
+					mexPrintf(
+							"the -cache option requires an additional "
+							"argument specifying the cache\ndirectory. See "
+							"'-help cache' for more details.\n");
 					return;
 				}
-				global_ctl_parameters.push_back(get_ctl_parameter(&argv, &argc, start_argc, "global", 2));
+				cache_directory = argv[1];
+				argv++;
+				argc--;
 			}
-			else if (!strcmp(argv[0], "-global_param3") || !strcmp(argv[0], "-gp3"))
+			else if (!strcmp(argv[0], "-cache_size"))
 			{
-				if (argc < 5)
+				if (argc == 1)
 				{
-					mexPrintf("the -global_param3 option requires four "
-							"additional arguments specifying the\nparameter "
-							"name and value.\nSee '-help param' for more "
-							"details.\n");
+					mexPrintf(
+							"the -cache_size option requires an additional "
+							"argument specifying the\nsize of the cache in "
+							"megabytes.\n");
 					return;
-                    
 				}
-				global_ctl_parameters.push_back(get_ctl_parameter(&argv, &argc, start_argc, "global", 2));
+				cache_megabytes = getfloat(argv[1], "size of the -cache_size");
+				if (cache_megabytes <= 0.0)
+				{
+					mexPrintf("the -cache_size must be more than 0 megabytes.\n");
+					return;
+				}
+				argv++;
+				argc--;
 			}
-			else if (!strncmp(argv[0], "-verbose", 2))
+			else if (!strcmp(argv[0], "-cache_stats"))
 			{
-				verbosity++;
+				cache_stats = TRUE;
 			}
-			else if (!strncmp(argv[0], "-quiet", 2))
+			else if (!strcmp(argv[0], "-flush_cache"))
 			{
-				verbosity--;
+				flush_ctl_module_cache();
+				flushed_cache = TRUE;
 			}
-			else if (!strncmp(argv[0], "-force", 5))
+			else if (!strcmp(argv[0], "-pool_size"))
 			{
-				force_overwrite_output_file = TRUE;
+				if (argc == 1)
+				{
+					mexPrintf(
+							"the -pool_size option requires an additional "
+							"argument specifying the\nmegabytes of idle "
+							"buffers kept between frames and calls.\n");
+					return;
+				}
+				double pool_megabytes = getfloat(argv[1], "size of the -pool_size");
+				if (pool_megabytes < 0.0)
+				{
+					mexPrintf("the -pool_size can not be less than 0 megabytes.\n");
+					return;
+				}
+				buffer_pool().set_max_bytes(pool_megabytes * 1e6);
+				pool_changed = TRUE;
+				argv++;
+				argc--;
 			}
-			else if (!strncmp(argv[0], "-noalpha", 2))
+			else if (!strcmp(argv[0], "-prepare"))
 			{
-				noalpha = TRUE;
+				prepare = TRUE;
+			}
+			else if (!strcmp(argv[0], "-release_pool"))
+			{
+				buffer_pool().release_idle();
+				pool_changed = TRUE;
 			}
 			else if (!strncmp(argv[0], "-", 1))
 			{
@@ -450,7 +1902,13 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 			}
 			else
 			{
-				input_image_files.push_back(argv[0]);
+				int taken = add_source(argc, argv, &input_image_files, &sequences);
+				if (taken == 0)
+				{
+					return;
+				}
+				argv += taken - 1;
+				argc -= taken - 1;
 			}
             
             
@@ -465,140 +1923,123 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 		{
 			ctl_operations.push_back(new_ctl_operation);
 		}
-		if (input_image_files.size() < 2)
+        
+		if (cache_directory != NULL)
 		{
-			mexPrintf(
-					"one or more source filenames and a destination "
-					"file or directory must be\nprovided. if more than one "
-					"source filenames is provided then the last argument\nmust "
-					"be a directory. see -help for more details.\n");
+			cache = open_render_cache(cache_directory, cache_megabytes);
+		}
+		if (cache_stats)
+		{
+			if (cache == NULL)
+			{
+				mexPrintf("the -cache_stats option requires -cache <directory>.\n");
+				return;
+			}
+			plhs[0] = cache_stats_to_mxarray(cache);
 			return;
 		}
-        
-		char *output_slash = NULL;
-		const char *outputFile = input_image_files.back();
-		input_image_files.pop_back();
-        
-		struct stat file_status;
-		if (stat(outputFile, &file_status) >= 0)
+
+		if (lut_shaper == Lut3D::LOG2 && !lut_range_given)
+		{
+			// Stops around scene linear 0.18.
+			lut_range[0] = -12.0;
+			lut_range[1] = 10.0;
+		}
+
+		if (prepare)
 		{
-			if (S_ISDIR(file_status.st_mode))
+			if (input_array != NULL || input_image_files.size() > 0 || sweep_name != NULL)
 			{
-				memset(output_path, 0, sizeof(output_path));
-				strncpy(output_path, outputFile, MAXPATHLEN);
-				outputFile = output_path;
-				output_slash = output_path + strlen(output_path);
-				if (*output_slash != '/')
-				{
-					*(output_slash++) = '/';
-					*output_slash = 0;
-				}
+				mexPrintf(
+						"-prepare takes only options, the sources and "
+						"destination are given to\n-apply. -sweep can not "
+						"be prepared. See '-help prepare' for more details.\n");
+				return;
 			}
-			else if (S_ISREG(file_status.st_mode))
+
+			std::auto_ptr<prepared_t> pipeline(new prepared_t(compression));
+			for (CTLOperations::const_iterator op = ctl_operations.begin(); op != ctl_operations.end(); op++)
 			{
-				if (input_image_files.size() > 1)
-				{
-					mexPrintf(
-							"When providing more than one source "
-							"image the destination must be a\ndirectory.\n");
-					return;
-				}
-				else
+				ctl_operation_t ctl_operation;
+				ctl_operation.filename = pipeline->keep(op->filename);
+				for (CTLParameters::const_iterator p = op->local.begin(); p != op->local.end(); p++)
 				{
-					if (!force_overwrite_output_file)
-					{
-						mexPrintf(
-								"The destination file %s already exists.\n"
-								"Cravenly refusing to overwrite unless you supply "
-								"the -force option.\n", outputFile);
-						return;
-					}
-					else
-					{
-						// File exists, but we treat it as if it doesn't (see
-						// if(output_slash==NULL) {...} down below...
-						output_slash = NULL;
-					}
+					ctl_operation.local.push_back(*p);
+					ctl_operation.local.back().name = pipeline->keep(p->name);
 				}
+				pipeline->ctl_operations.push_back(ctl_operation);
 			}
-			else
-			{
-				mexPrintf(
-						"Specified destination is something other than "
-						"a file or directory. That's\nprobably a bad idea.\n");
-				return;
-			}
-		}
-		else
-		{
-			if (errno != ENOENT)
+			for (CTLParameters::const_iterator p = global_ctl_parameters.begin(); p != global_ctl_parameters.end(); p++)
 			{
-				mexPrintf("Unable to get information about %s (%s).\n", outputFile, strerror(errno));
-				return;
+				pipeline->global_ctl_parameters.push_back(*p);
+				pipeline->global_ctl_parameters.back().name = pipeline->keep(p->name);
 			}
-			if (input_image_files.size() != 1)
+			pipeline->input_scale = input_scale;
+			pipeline->output_scale = output_scale;
+			pipeline->desired_format = desired_format;
+			pipeline->force_overwrite_output_file = force_overwrite_output_file;
+			pipeline->noalpha = noalpha;
+			pipeline->async = async;
+			pipeline->threads = threads;
+			pipeline->options = options;
+			pipeline->frames_in_flight = frames_in_flight;
+			pipeline->read_ahead = read_ahead;
+			pipeline->cache = cache;
+			pipeline->region = region;
+			pipeline->lut_size = lut_size;
+			pipeline->lut_shaper = lut_shaper;
+			pipeline->lut_range[0] = lut_range[0];
+			pipeline->lut_range[1] = lut_range[1];
+
+			// Scripts that do not load fail here rather than at -apply.
+			pipeline->options.threads = set_thread_budget(threads, frames_in_flight > 1);
+			prepare_ctl_chain(pipeline->ctl_operations, pipeline->options.threads);
+			if (lut_size > 0)
 			{
-				mexPrintf(
-						"When specifying more than one source file "
-						"you must specify the destination as\na directory "
-						"that already exists.\nUnable to stat '%s' (%s)\n",
-						outputFile, strerror(errno));
-				return;
+				pipeline->lut.reset(new Lut3D(lut_size, lut_shaper, lut_range[0], lut_range[1],
+				                              pipeline->ctl_operations, pipeline->global_ctl_parameters, pipeline->options));
 			}
+			prepared_pipelines[next_job_id] = pipeline.release();
+			plhs[0] = mxCreateDoubleScalar(next_job_id++);
+			return;
+		}
+
+		if ((flushed_cache || set_default_threads || pool_changed) && input_array == NULL && input_image_files.size() == 0)
+		{
+			return;
+		}
+		job.reset(new Job(input_scale, output_scale, compression, ctl_operations, global_ctl_parameters, frames_in_flight, read_ahead));
+		job->set_options(options);
+		job->set_cache(cache);
+		job->set_region(region);
+		if (lut_size > 0)
+		{
+			job->set_lut(lut_size, lut_shaper, lut_range[0], lut_range[1]);
 		}
         
-		if (output_slash == NULL)
+		if (sweep_name != NULL)
 		{
-			// This is the case when our outputFile is a single file. We do a bunch
-			// of sanity checking between the extension of the specified file
-			// (if any) and the -format option (if any).
-			char *dot = (char *) strrchr(outputFile, '.');
-			if (dot == NULL && desired_format.ext == NULL)
+			if (lut_size > 0)
 			{
-				mexPrintf(
-						"You have not explicitly provided an output "
-						"format, and the output file name\ndoes not not contain "
-						"an extension. Please add an extension to the output "
-						"file\nor use the -format option to specify the desired "
-						"output format.\n");
+				mexPrintf("-sweep changes a parameter the baked LUT would hold fixed, so it can\nnot be used with -bake_lut.\n");
 				return;
 			}
-			else if (dot != NULL)
+			if (input_array != NULL)
 			{
-				if (desired_format.ext == NULL)
-				{
-					actual_format = find_format(dot + 1,
-							                    " specified implicitly (by "
-									            "the extension) for\noutput file "
-									            "format. Please fix this or use\n"
-									            "the -format option to specify "
-									            "the desired output format.\n");
-				}
-				else
-				{
-					// HACK aces format file type check
-                    const char *ext = desired_format.ext;
-                    static const char exrext[] = "exr";
-                    if (!strcmp(ext, "aces"))
-                        ext = exrext;
-                        if (strcmp(ext, dot + 1) && !force_overwrite_output_file)
-                        {
-                            mexPrintf(
-                                    "You have specified a destination file "
-                                    "type with the -format option, but the\noutput "
-                                    "file extension does not match the format "
-                                    "specified by the -format option.\nCravenly "
-                                    "refusing to do this unless you specify the "
-                                    "-force option (which\nwill make the -format "
-                                    "option take priority).\n");
-                            return;
-                        }
-					actual_format = desired_format;
-				}
+				mxarray_to_fb(input_array, input_scale, region, job->image());
+			}
+			if (!queue_sweep(job.get(), input_array != NULL, input_image_files, sequences, sweep_name, sweep_values,
+			                 desired_format, force_overwrite_output_file, noalpha))
+			{
+				return;
 			}
 		}
-        
-		if (verbosity > 1)
+		else if (!queue_transform(job.get(), nlhs, input_array, input_scale, region, noalpha, input_image_files, sequences,
+		                          desired_format, force_overwrite_output_file))
+		{
+			return;
+		}
+		else if (verbosity > 1 && !job->in_memory())
 		{
 			mexPrintf("global ctl parameters:\n");
             
@@ -619,79 +2060,13 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 			mexPrintf("\n");
 		}
         
-		while (input_image_files.size() > 0)
-		{
-			const char *inputFile = input_image_files.front();
-            
-			if (output_slash != NULL)
-			{
-				const char *input_slash = strrchr(inputFile, '/');
-				if (input_slash == NULL)
-				{
-					input_slash = (char *) inputFile;
-				}
-				else
-				{
-					input_slash++;
-				}
-				strcpy(output_slash, input_slash);
-				char *dot = (char *) strrchr(outputFile, '.');
-				if (dot != NULL)
-				{
-					dot++;
-					if (desired_format.ext != NULL)
-					{
-						// HACK aces format file type check
-                        const char *ext = desired_format.ext;
-                        static const char exrext[] = "exr";
-                        if (!strcmp(ext, "aces"))
-                            ext = exrext;
-                            strcpy(dot, ext);
-                            actual_format = desired_format;
-                            }
-					else
-					{
-						actual_format = find_format(dot, " (determined from destination file extension).");
-					}
-				}
-			}
-            
-			if (force_overwrite_output_file)
-			{
-				if (unlink(outputFile) < 0)
-				{
-					if (errno != ENOENT)
-					{
-						mexPrintf("Unable to remove existing file named "
-								"'%s' (%s).\n", outputFile, strerror(errno));
-						return;
-					}
-				}
-			}
-			if (access(outputFile, F_OK) >= 0)
-			{
-                mexPrintf("Cravenly refusing to overwrite the file '%s'.\n", outputFile);
-				return;
-			}
-			actual_format.squish = noalpha;
-			transform(inputFile, outputFile, input_scale, output_scale, &actual_format, &compression, ctl_operations, global_ctl_parameters);
-			input_image_files.pop_front();
-		}
+		run_call_job(nlhs, plhs, job, input_array, async, threads, frames_in_flight, 0);
         
         
 	} catch (std::exception &e)
 	{
 		mexPrintf("exception thrown (oops...): %s\n", e.what());
 	}
-    
-    /*
-    if( argc )
-    {
-        for( j=argc-1; j>=0; j-- )
-            mxFree( argv[j] );
-        mxFree( argv );
-    }
-    */
 }
 
 
@@ -702,14 +2077,31 @@ void usagePrompt(const char *section) {
 "            converting the file format in the process\n"
 "\nusage:\n"
 "    ctlrender [<options> ...] <source file...> <destination>\n"
+"    img = ctl(<image>, [<options> ...])\n"
+"    [img, stats] = ctl(<image>, [<options> ...])\n"
+"    stats = ctl([<options> ...] <source file...> <destination>)\n"
+"    job = ctl('-async', [<options> ...] ...)\n"
+"    ctl('-status' | '-wait' | '-cancel' | '-release', job)\n"
+"    h = ctl('-prepare', [<options> ...])\n"
+"    ctl('-apply', h, <image> | <source file...> [<destination>])\n"
 "\n"
 "\n"
 "options:\n"
 "\n"
+"    <image>               A single or double H x W x 3 (or H x W x 4) array\n"
+"                          may be given in place of the source and\n"
+"                          destination files. The transformed image is\n"
+"                          returned as an array of the same class without\n"
+"                          going through a file. A single source file with no\n"
+"                          destination is returned as a single array.\n"
+"\n"
 "    <source file...>      One or more source files may be specified in a\n"
 "                          space separated list. Note to non-cygwin using\n"
 "                          Windows users: wild card ('*') expansions are not\n"
-"                          supported.\n"
+"                          supported. A numbered sequence is given as a\n"
+"                          pattern followed by its frames, for example\n"
+"                          plate.%06d.dpx 1001-6000. Details on this are\n"
+"                          provided with '-help sequence'.\n"
 "\n"
 "    <destination>         In the case that only one source file is specified\n"
 "                          this may be either a filename or a directory. If\n"
@@ -747,8 +2139,321 @@ void usagePrompt(const char *section) {
 "    -param2 ...           Details on this and similar options are provided\n"
 "    -param3 ...           with '-help param'\n"
 "\n"
+"    -threads <count>      Number of threads for this call, shared by the\n"
+"                          ctl scripts and the OpenEXR compression. When\n"
+"                          several files are pipelined (see -inflight)\n"
+"                          a third go to compression and the rest to the\n"
+"                          scripts; otherwise each uses them all in turn.\n"
+"                          The default of 0 uses one thread per\n"
+"                          processor. The output does not depend on the\n"
+"                          number of threads.\n"
+"\n"
+"    -default_threads <count>\n"
+"                          Sets the -threads count of later calls in this\n"
+"                          MATLAB session. With no files or image it does\n"
+"                          nothing else.\n"
+"\n"
+"    -inflight <count>     Number of frames read, transformed and written\n"
+"                          at the same time when more than one source file\n"
+"                          is given. Memory use grows with the count. The\n"
+"                          default is 3, 1 processes one file at a time.\n"
+"\n"
+"    -read_ahead <count>   Number of source files decoded ahead of the one\n"
+"                          being transformed, on threads of their own, so\n"
+"                          they are ready when their turn comes. Memory use\n"
+"                          grows with the count. The default is 2, 0 reads\n"
+"                          each file in its turn. Files transformed with\n"
+"                          -strip_rows are not read ahead.\n"
+"\n"
+"    -strip_rows <rows>    Reads, transforms and writes files this many\n"
+"                          scanlines at a time, so that memory use depends\n"
+"                          on the width of a frame rather than its size.\n"
+"                          Only for scripts that treat every pixel on its\n"
+"                          own. 8/16 bit and float RGB or grey TIFF files\n"
+"                          in strips, compressed or not, 8 to 16 bit DPX\n"
+"                          and OpenEXR files are streamed, to the same\n"
+"                          formats or to ACES, other files are transformed\n"
+"                          whole. The default of 0 always transforms whole\n"
+"                          frames.\n"
+"\n"
+"    -tile <w> <h>         Writes OpenEXR files as tiles of w by h pixels\n"
+"                          rather than scanlines. With -strip_rows each row\n"
+"                          of tiles is compressed while the next strip is\n"
+"                          transformed. Tiles hold half or float samples,\n"
+"                          so other bit depths are raised to the nearer of\n"
+"                          the two. ACES output stays in scanlines.\n"
+"\n"
+"    -tile_levels <levels> Levels of tiled files: 'one' (the default),\n"
+"                          'mipmap' or 'ripmap'. Lower levels are averaged\n"
+"                          down from the full resolution image a scanline\n"
+"                          at a time, so they add a row of tiles per level\n"
+"                          rather than a frame to memory.\n"
+"\n"
+"    -cache <directory>    Keeps the files written in <directory> and takes\n"
+"                          them from there when the same source, scripts\n"
+"                          and settings are given again. Details on this\n"
+"                          are provided with '-help cache'.\n"
+"\n"
+"    -pool_size <MB>       Megabytes of frame buffers and ctl channels kept\n"
+"                          idle between frames and between calls, so they\n"
+"                          are not allocated again for every frame. It\n"
+"                          holds for the rest of the MATLAB session. The\n"
+"                          default is 2048, 0 keeps nothing. The least\n"
+"                          recently used buffers are freed first.\n"
+"\n"
+"    -release_pool         Frees the idle buffers now. 'clear mex' also\n"
+"                          frees them.\n"
+"\n"
+"    -flush_cache          Releases the compiled CTL modules that are kept\n"
+"                          loaded between calls. Modules are reloaded anyway\n"
+"                          when the file, or a module it imports, changes\n"
+"                          on disk. 'clear mex' also releases them.\n"
+"\n"
+"    -async                Returns a job id at once and runs the transform in\n"
+"                          the background. Details on this are provided\n"
+"                          with '-help async'.\n"
+"\n"
+"    -prepare              Checks the options and loads the scripts once,\n"
+"                          and returns a pipeline that '-apply' runs on\n"
+"                          any number of images. Details on this are\n"
+"                          provided with '-help prepare'.\n"
+"\n"
+"    -sweep <name> <start>:<step>:<stop>\n"
+"                          Transforms the source once for each value of the\n"
+"                          parameter <name>, decoding it only once. Details\n"
+"                          on this are provided with '-help sweep'.\n"
+"\n"
+"    -roi <x> <y> <width> <height>\n"
+"    -preview_step <step>  Transforms only part of the image, or only every\n"
+"                          <step>-th pixel of it. Details on this are\n"
+"                          provided with '-help preview'.\n"
+"\n"
+"    -bake_lut <size>      Bakes the ctl scripts into a 3D LUT and applies\n"
+"                          that to every frame. Details on this are\n"
+"                          provided with '-help lut'.\n"
+"\n"
 "    -verbose              Increases the level of output verbosity.\n"
 "    -quiet                Decreases the level of output verbosity.\n"
+"\n"
+"    Timings of every stage of every frame can be returned as an extra\n"
+"    output. Details on this are provided with '-help stats'.\n"
+"");
+	} else if(!strncmp(section, "stats", 5)) {
+		mexPrintf(""
+"timings:\n"
+"\n"
+"    When asked for one more output than usual (the image of an in memory\n"
+"    transform, or nothing when writing files, or the result of '-wait')\n"
+"    ctl returns where the time went as a struct:\n"
+"\n"
+"    stats.frames(i)       One element per frame, in the order they were\n"
+"                          finished, with the fields:\n"
+"        input, output     The file names.\n"
+"        pixels            Pixels evaluated.\n"
+"        read              Seconds decoding the source file.\n"
+"        mkresult          Seconds setting up the ctl inputs.\n"
+"        operations        Seconds evaluating each -ctl script, summed\n"
+"                          over every thread that ran it.\n"
+"        lut               Seconds applying a baked 3D LUT.\n"
+"        mkimage           Seconds gathering the ctl outputs.\n"
+"        write             Seconds encoding the destination file.\n"
+"        total             Seconds for the whole frame.\n"
+"        bytes_read, bytes_written\n"
+"                          Sizes of the source and destination files.\n"
+"        cached            True when the file was taken from the -cache\n"
+"                          directory rather than transformed.\n"
+"\n"
+"    stats.total           The same fields summed over all frames, and:\n"
+"        frames            Number of frames.\n"
+"        elapsed           Wall clock seconds for the whole call. With\n"
+"                          frames in flight this is less than the sum.\n"
+"        mpix_per_s        Pixels per second over the whole call.\n"
+"        read_mb_per_s, write_mb_per_s\n"
+"                          File bytes per second of decoding and\n"
+"                          encoding.\n"
+"        cache_hits        Number of frames taken from the -cache\n"
+"                          directory.\n"
+"\n");
+	} else if(!strncmp(section, "sequence", 3)) {
+		mexPrintf(""
+"image sequences:\n"
+"\n"
+"    A source file name holding a frame number pattern stands for a whole\n"
+"    numbered sequence, and the argument after it gives its frames:\n"
+"\n"
+"    ctl('-ctl', 'odt.ctl', 'plate.%%06d.dpx', '1001-6000', 'out/')\n"
+"\n"
+"    The pattern is a printf style %%d or %%0<n>d, or a run of '#' with\n"
+"    one digit per '#' (plate.######.dpx is the same as plate.%%06d.dpx).\n"
+"    The frames are a comma separated list of <first>, <first>-<last> or\n"
+"    <first>-<last>x<step>, such as 1001-6000x2 or 1-10,20,30-40.\n"
+"\n"
+"    The file names are made from the pattern as the frames are reached,\n"
+"    rather than passed in one string per frame, and a destination file\n"
+"    that is already there is only refused (or replaced with -force) when\n"
+"    its frame comes up; the frames before it are still written. A name\n"
+"    holding '#' or %%d that is that of an existing file is the file, not\n"
+"    a pattern. As with any list of several source files the destination\n"
+"    must be an existing directory, and each frame keeps its own name\n"
+"    there. Sequences and single files may be mixed. The next frames are\n"
+"    decoded while the current one is transformed, see -read_ahead.\n"
+"\n");
+	} else if(!strncmp(section, "sweep", 2)) {
+		mexPrintf(""
+"parameter sweeps:\n"
+"\n"
+"    '-sweep <name> <start>:<step>:<stop>' transforms a single source once\n"
+"    for each value from <start> to <stop>, in steps of <step> (1 when\n"
+"    given as <start>:<stop>), as MATLAB's colon operator would list them:\n"
+"\n"
+"    imgs = ctl(img, '-ctl', 'look.ctl', '-sweep', 'exposure', '0:0.1:2')\n"
+"    ctl('-ctl', 'look.ctl', '-sweep', 'exposure', '0:0.1:2', ...\n"
+"        'plate.exr', 'out/look.%%03d.exr')\n"
+"\n"
+"    The parameter is the one a -param1 of that name gives, either to the\n"
+"    scripts it was given to or, when no script was given it, to every\n"
+"    script. The source is decoded, and its channels handed to the\n"
+"    interpreter, only once; between values only the parameter changes.\n"
+"\n"
+"    Given an image array, or a single source file and no destination,\n"
+"    the results are returned as one H x W x C x N array of the class of\n"
+"    the input (single for files), result i in (:, :, :, i). Given a\n"
+"    destination, which must name numbered frames as a sequence does, the\n"
+"    result for the i-th value is written to frame i. -sweep can not be\n"
+"    used with -bake_lut, several source files or a source sequence.\n"
+"\n");
+	} else if(!strncmp(section, "cache", 2)) {
+		mexPrintf(""
+"render cache:\n"
+"\n"
+"    With '-cache <directory>' every file a call writes is also kept in\n"
+"    <directory>, named by a hash of what made it: the identity of the\n"
+"    source file (device, inode, size and modification time), the text of\n"
+"    each ctl script, the parameter values, the input and output scales,\n"
+"    the output format and bit depth, -noalpha, the compression and the\n"
+"    -bake_lut settings. A later call that would make the same file puts\n"
+"    the kept one in place instead of reading and transforming the source:\n"
+"\n"
+"    ctl('-cache', '/scratch/ctlcache', '-ctl', 'odt.ctl', ...\n"
+"        'plate.%%06d.dpx', '1001-6000', 'out/')\n"
+"\n"
+"    Files are put in place with a hard link where the file system allows\n"
+"    one, and copied otherwise, so a file edited in place afterwards\n"
+"    changes the kept one too. The text of the modules a script imports\n"
+"    is hashed with it, taken from every file the import could resolve to\n"
+"    (next to the script, along CTL_MODULE_PATH or in the current\n"
+"    directory). Image arrays and -sweep results are not cached.\n"
+"\n"
+"        -cache_size <MB>      Size the kept files are held to. The least\n"
+"                              recently used are removed first. The\n"
+"                              default is 4000.\n"
+"\n"
+"        -cache_stats          Returns, for the -cache directory, the hits,\n"
+"                              misses, stores and evictions of this\n"
+"                              session and the entries and bytes kept,\n"
+"                              and transforms nothing.\n"
+"\n"
+"    The timings of a call (see '-help stats') mark each cached frame and\n"
+"    count them in total.cache_hits.\n"
+"\n");
+	} else if(!strncmp(section, "async", 5)) {
+		mexPrintf(""
+"asynchronous jobs:\n"
+"\n"
+"    With '-async' the call returns a job id as soon as its arguments have\n"
+"    been checked, and the frames are transformed in the background. The\n"
+"    options and files are the same as for a blocking call. The job is then\n"
+"    managed with:\n"
+"\n"
+"    s = ctl('-status', job)   Returns a struct with the fields state\n"
+"                              ('running', 'done', 'failed' or\n"
+"                              'cancelled'), frames_done, frames_total,\n"
+"                              elapsed (seconds), frames_per_second,\n"
+"                              outputs (the files written so far) and\n"
+"                              error.\n"
+"\n"
+"    r = ctl('-wait', job)     Blocks until the job is over. For an\n"
+"                              in memory job r is the transformed image,\n"
+"                              otherwise a cell array of the files written.\n"
+"                              A second output receives the timings, see\n"
+"                              '-help stats'.\n"
+"\n"
+"    ctl('-cancel', job)       Frames that have not been started are\n"
+"                              skipped, frames in flight are finished.\n"
+"\n"
+"    ctl('-release', job)      Forgets the job, waiting for the frames in\n"
+"                              flight first. 'clear mex' releases every job.\n"
+"\n"
+"    Each job keeps its own copy of the arguments, so the strings and the\n"
+"    image array passed to ctl may be changed or cleared straight away.\n"
+"\n");
+	} else if(!strncmp(section, "prepare", 4)) {
+		mexPrintf(""
+"prepared pipelines:\n"
+"\n"
+"    '-prepare' takes the options of a call without its sources and\n"
+"    destination. They are parsed and checked once, the ctl scripts are\n"
+"    loaded and compiled, a -bake_lut table is baked, and the id of the\n"
+"    pipeline is returned:\n"
+"\n"
+"    h = ctl('-prepare', '-ctl', 'rrt.ctl', '-ctl', 'odt.ctl', '-format', 'exr')\n"
+"    img2 = ctl('-apply', h, img)\n"
+"    ctl('-apply', h, 'plate.%%06d.dpx', '1001-1100', 'out/')\n"
+"    ctl('-release', h)\n"
+"\n"
+"    '-apply' runs the pipeline on an image array, or on source files and\n"
+"    a destination, which are all it parses. The results and timings are\n"
+"    those of the same call with the options, as are -async jobs. Frame\n"
+"    and channel buffers come from the buffer pool (see -pool_size), so\n"
+"    they are kept from one -apply to the next.\n"
+"\n"
+"    '-release' forgets the pipeline, once every -async job applying it\n"
+"    has been released. Scripts changed on disk are reloaded, as they are\n"
+"    for any call. -sweep can not be prepared.\n"
+"\n");
+	} else if(!strncmp(section, "preview", 3)) {
+		mexPrintf(""
+"previews:\n"
+"\n"
+"    '-roi <x> <y> <width> <height>' transforms only the <width> x <height>\n"
+"    pixels whose upper left corner is in column <x> and row <y>, counted\n"
+"    from 1 as MATLAB does. A region reaching past the right or bottom edge\n"
+"    stops there. '-preview_step <step>' keeps every <step>-th column and\n"
+"    row, starting with the first of the region (or of the image):\n"
+"\n"
+"    crop = ctl(img, '-ctl', 'look.ctl', '-roi', '513', '257', '512', '512')\n"
+"    thumb = ctl('-ctl', 'look.ctl', '-preview_step', '4', 'plate.exr')\n"
+"\n"
+"    Only those pixels are handed to the ctl scripts, so a step of 4 runs\n"
+"    them over a sixteenth of the image. From a file, rows above, below\n"
+"    and between the kept ones are not decoded where the format can be\n"
+"    read in strips (see -strip_rows); the kept rows are decoded whole.\n"
+"\n"
+"    Both apply to image arrays, to single source files returned to MATLAB\n"
+"    and to -sweep, not to files transformed into destination files.\n"
+"\n");
+	} else if(!strncmp(section, "lut", 3)) {
+		mexPrintf(""
+"baked 3D LUT:\n"
+"\n"
+"    With '-bake_lut <size>' the ctl scripts are evaluated once over a\n"
+"    <size> x <size> x <size> lattice of R, G and B values, and every frame is\n"
+"    then processed by tetrahedral interpolation in that lattice instead of\n"
+"    running the scripts for every pixel. This is only valid when the\n"
+"    scripts treat every pixel independently and their parameters do not\n"
+"    change from frame to frame. Alpha is passed through.\n"
+"\n"
+"        -lut_shaper <shaper>  'linear' places the lattice points evenly in\n"
+"                              the input values, 'log2' evenly in their\n"
+"                              log2. The default is 'linear'.\n"
+"\n"
+"        -lut_range <lo> <hi>  Input range covered by the lattice, in\n"
+"                              shaper units. Inputs outside it are clamped.\n"
+"                              The default is 0 1 for 'linear' and -12 10\n"
+"                              (stops) for 'log2'.\n"
+"\n"
+"    The first frame is also evaluated exactly on a sample of its pixels,\n"
+"    and the largest difference to the interpolated result is printed.\n"
 "");
 	} else if(!strncmp(section, "format", 1)) {
 		mexPrintf(""
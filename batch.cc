@@ -0,0 +1,281 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "batch.hh"
+#include <Iex.h>
+#include <exception>
+
+class BatchTask: public IlmThread::Task
+{
+	public:
+		BatchTask(IlmThread::TaskGroup *group, Batch *batch, const char *inputFile, const char *outputFile, const format_t &format,
+		          read_ahead_t *ahead)
+			: IlmThread::Task(group), _batch(batch), _inputFile(inputFile), _outputFile(outputFile), _format(format), _ahead(ahead)
+		{
+		}
+
+		virtual void execute()
+		{
+			_batch->run(_inputFile, _outputFile, _format, _ahead);
+		}
+
+	private:
+		Batch *_batch;
+		std::string _inputFile;
+		std::string _outputFile;
+		format_t _format;
+		read_ahead_t *_ahead;
+};
+
+class ReadTask: public IlmThread::Task
+{
+	public:
+		ReadTask(IlmThread::TaskGroup *group, Batch *batch, read_ahead_t *ahead)
+			: IlmThread::Task(group), _batch(batch), _ahead(ahead)
+		{
+		}
+
+		virtual void execute()
+		{
+			double start = wall_clock();
+
+			try
+			{
+				if (!_batch->failed() && !_batch->cancelled())
+				{
+					read_image(_ahead->input.c_str(), _batch->_input_scale, _ahead->image.get(), &_ahead->format, _ahead->alpha);
+				}
+			}
+			catch (std::exception &e)
+			{
+				_ahead->error = e.what();
+			}
+			_ahead->seconds = wall_clock() - start;
+			_ahead->done.post();
+		}
+
+	private:
+		Batch *_batch;
+		read_ahead_t *_ahead;
+};
+
+Batch::Batch(float input_scale, float output_scale, Compression *compression,
+             const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters,
+             const transform_options_t &options, int frames_in_flight, const Lut3D *lut, int read_ahead)
+	: _input_scale(input_scale), _output_scale(output_scale), _compression(compression),
+	  _ctl_operations(ctl_operations), _global_ctl_parameters(global_ctl_parameters), _options(options), _lut(lut),
+	  _pool(frames_in_flight > 1 ? frames_in_flight : 0),
+	  _group(new IlmThread::TaskGroup()),
+	  _slots(frames_in_flight > 1 ? frames_in_flight : 1),
+	  _cancelled(false), _frames_done(0),
+	  _read_ahead(read_ahead > 0 ? read_ahead : 0), _readers(_read_ahead),
+	  _reads(new IlmThread::TaskGroup())
+{
+}
+
+Batch::~Batch()
+{
+	// Deleting the group waits for its tasks. Frames read ahead but never
+	// added go once their reads are done.
+	delete _group;
+	delete _reads;
+	for (std::list<read_ahead_t *>::iterator a = _ahead.begin(); a != _ahead.end(); a++)
+	{
+		delete *a;
+	}
+}
+
+void Batch::add(const char *inputFile, const char *outputFile, const format_t &format)
+{
+	read_ahead_t *ahead = NULL;
+
+	if (!_ahead.empty() && _ahead.front()->input == inputFile)
+	{
+		ahead = _ahead.front();
+		_ahead.pop_front();
+	}
+
+	_slots.wait();
+	if (failed() || cancelled())
+	{
+		if (ahead != NULL)
+		{
+			ahead->done.wait();
+			delete ahead;
+		}
+		_slots.post();
+		return;
+	}
+	// With a pool of no threads the task runs here, which is the serial
+	// one frame at a time behavior.
+	_pool.addTask(new BatchTask(_group, this, inputFile, outputFile, format, ahead));
+}
+
+void Batch::read_ahead(const char *inputFile, const format_t &format)
+{
+	if (_read_ahead == 0 || _options.strip_rows > 0 || failed() || cancelled())
+	{
+		return;
+	}
+
+	read_ahead_t *ahead = new read_ahead_t;
+	ahead->input = inputFile;
+	ahead->seconds = 0.0;
+	try
+	{
+		ahead->alpha = source_alpha_used(_ctl_operations, format, _lut);
+	}
+	catch (std::exception &)
+	{
+		// The frame fails with the same error once it is transformed.
+		ahead->alpha = true;
+	}
+	_ahead.push_back(ahead);
+	_readers.addTask(new ReadTask(_reads, this, ahead));
+}
+
+void Batch::wait()
+{
+	delete _group;
+	_group = new IlmThread::TaskGroup();
+}
+
+bool Batch::failed()
+{
+	IlmThread::Lock lock(_mutex);
+	return !_error.empty();
+}
+
+std::string Batch::error()
+{
+	IlmThread::Lock lock(_mutex);
+	return _error;
+}
+
+void Batch::cancel()
+{
+	IlmThread::Lock lock(_mutex);
+	_cancelled = true;
+}
+
+bool Batch::cancelled()
+{
+	IlmThread::Lock lock(_mutex);
+	return _cancelled;
+}
+
+size_t Batch::frames_done()
+{
+	IlmThread::Lock lock(_mutex);
+	return _frames_done;
+}
+
+std::vector<std::string> Batch::outputs()
+{
+	IlmThread::Lock lock(_mutex);
+	return _outputs;
+}
+
+std::vector<transform_stats_t> Batch::stats()
+{
+	IlmThread::Lock lock(_mutex);
+	return _stats;
+}
+
+void Batch::run(const std::string &inputFile, const std::string &outputFile, format_t format, read_ahead_t *ahead)
+{
+	try
+	{
+		if (ahead != NULL)
+		{
+			ahead->done.wait();
+		}
+		if (!failed() && !cancelled())
+		{
+			transform_stats_t stats;
+			if (ahead == NULL)
+			{
+				transform(inputFile.c_str(), outputFile.c_str(), _input_scale, _output_scale, &format, _compression, _ctl_operations, _global_ctl_parameters, _options, _lut, &stats);
+			}
+			else
+			{
+				if (!ahead->error.empty())
+				{
+					THROW(Iex::BaseExc, ahead->error);
+				}
+				// The read overlapped earlier frames, so the total is the
+				// time the frame would have taken on its own.
+				double start = wall_clock();
+				stats.read = ahead->seconds;
+				transform_decoded(inputFile.c_str(), outputFile.c_str(), _input_scale, _output_scale, ahead->image.get(), ahead->format, &format, _compression, _ctl_operations, _global_ctl_parameters, _options, _lut, &stats);
+				stats.total = ahead->seconds + wall_clock() - start;
+			}
+
+			IlmThread::Lock lock(_mutex);
+			_frames_done++;
+			_outputs.push_back(outputFile);
+			_stats.push_back(stats);
+		}
+	}
+	catch (std::exception &e)
+	{
+		IlmThread::Lock lock(_mutex);
+		if (_error.empty())
+		{
+			_error = std::string(inputFile) + ": " + e.what();
+		}
+	}
+	delete ahead;
+	_slots.post();
+}
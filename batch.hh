@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_BATCH_INCLUDE)
+#define CTL_UTIL_CTLRENDER_BATCH_INCLUDE
+
+#include "transform.hh"
+#include "buffer_pool.hh"
+#include <list>
+#include <string>
+#include <vector>
+#include <IlmThreadPool.h>
+#include <IlmThreadMutex.h>
+#include <IlmThreadSemaphore.h>
+
+// Transforms a sequence of files with several frames in flight at once, so
+// that decoding the next frames and encoding the previous ones overlaps the
+// CTL evaluation of the current one. At most frames_in_flight frames being
+// transformed, and read_ahead more decoded ahead of their turn, exist at
+// any time, so frames_in_flight + read_ahead frame buffers; add() blocks
+// until one is done.
+//
+// The caller decides the output names and deals with existing files in
+// order, exactly as for a single transform() call.
+// A frame decoded by Batch::read_ahead before its turn comes.
+struct read_ahead_t
+{
+	std::string input;
+	bool alpha;
+	PooledFrame image;
+	format_t format;
+	double seconds;
+	std::string error;
+	IlmThread::Semaphore done;
+};
+
+class Batch
+{
+	public:
+		Batch(float input_scale, float output_scale, Compression *compression,
+		      const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters,
+		      const transform_options_t &options, int frames_in_flight, const Lut3D *lut = NULL, int read_ahead = 0);
+		~Batch();
+
+		void add(const char *inputFile, const char *outputFile, const format_t &format);
+
+		// Starts decoding inputFile on one of read_ahead threads of its own,
+		// so the add() of that file finds it decoded rather than reading it
+		// then. Files are read ahead in the order they are added, with the
+		// format they will be added with. Nothing is read ahead with no
+		// read ahead threads, or when frames are transformed a strip at a
+		// time.
+		void read_ahead(const char *inputFile, const format_t &format);
+
+		// Blocks until every frame added so far has been written.
+		void wait();
+
+		// Set once a frame has failed. The message is that of the first
+		// failure.
+		bool failed();
+		std::string error();
+
+		// Frames not started yet are skipped.
+		void cancel();
+
+		size_t frames_done();
+		std::vector<std::string> outputs();
+
+		// Timings of the frames written so far, in the order they finished.
+		std::vector<transform_stats_t> stats();
+
+	private:
+		friend class BatchTask;
+		friend class ReadTask;
+
+		void run(const std::string &inputFile, const std::string &outputFile, format_t format, read_ahead_t *ahead);
+		bool cancelled();
+
+		float _input_scale;
+		float _output_scale;
+		Compression *_compression;
+		const CTLOperations &_ctl_operations;
+		const CTLParameters &_global_ctl_parameters;
+		transform_options_t _options;
+		const Lut3D *_lut;
+
+		IlmThread::ThreadPool _pool;
+		IlmThread::TaskGroup *_group;
+		IlmThread::Semaphore _slots;
+		IlmThread::Mutex _mutex;
+		std::string _error;
+		bool _cancelled;
+		size_t _frames_done;
+		std::vector<std::string> _outputs;
+		std::vector<transform_stats_t> _stats;
+
+		int _read_ahead;
+		IlmThread::ThreadPool _readers;
+		IlmThread::TaskGroup *_reads;
+		std::list<read_ahead_t *> _ahead;
+};
+
+#endif
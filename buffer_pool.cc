@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "buffer_pool.hh"
+#include <CtlStdType.h>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+static const uint64_t huge_page_bytes = 2 * 1024 * 1024;
+
+// In floats.
+static uint64_t size_class(uint64_t count)
+{
+	uint64_t bytes = count * sizeof(float);
+	uint64_t size = 4096;
+
+	if (bytes >= huge_page_bytes)
+	{
+		return (bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes / sizeof(float);
+	}
+	while (size < bytes)
+	{
+		size *= 2;
+	}
+	return size / sizeof(float);
+}
+
+// Asks for the whole huge pages inside a large buffer to be backed by
+// transparent huge pages. Systems without them, or with them turned off,
+// just keep the small pages.
+static void advise_huge_pages(const float *data, uint64_t count)
+{
+#if defined(MADV_HUGEPAGE)
+	uintptr_t begin = ((uintptr_t) data + huge_page_bytes - 1) & ~(uintptr_t) (huge_page_bytes - 1);
+	uintptr_t end = (uintptr_t) (data + count) & ~(uintptr_t) (huge_page_bytes - 1);
+
+	if (end > begin)
+	{
+		madvise((void *) begin, end - begin, MADV_HUGEPAGE);
+	}
+#else
+	(void) data;
+	(void) count;
+#endif
+}
+
+static uint64_t frame_count(const ctl::dpx::fb<float> &image_buffer)
+{
+	return (uint64_t) image_buffer.pixels() * image_buffer.depth();
+}
+
+BufferPool::BufferPool(double max_bytes)
+	: _max_bytes(max_bytes), _clock(0), _hits(0), _misses(0)
+{
+}
+
+BufferPool::~BufferPool()
+{
+	for (size_t i = 0; i < _frames.size(); i++)
+	{
+		delete _frames[i].image;
+	}
+}
+
+void BufferPool::set_max_bytes(double max_bytes)
+{
+	IlmThread::Lock lock(_mutex);
+	_max_bytes = max_bytes;
+	trim();
+}
+
+double BufferPool::max_bytes()
+{
+	IlmThread::Lock lock(_mutex);
+	return _max_bytes;
+}
+
+ctl::dpx::fb<float> *BufferPool::acquire(uint64_t count)
+{
+	uint64_t size = count > 0 ? size_class(count) : 0;
+	frame_t frame;
+
+	{
+		IlmThread::Lock lock(_mutex);
+		int best = -1;
+
+		for (size_t i = 0; i < _frames.size(); i++)
+		{
+			const frame_t &f = _frames[i];
+			if (!f.busy && (count == 0 || (f.capacity >= count && f.capacity <= 2 * size)) &&
+			    (best < 0 || f.used > _frames[best].used))
+			{
+				best = i;
+			}
+		}
+		if (best >= 0)
+		{
+			_frames[best].busy = true;
+			_frames[best].used = ++_clock;
+			_hits++;
+			return _frames[best].image;
+		}
+		_misses++;
+	}
+
+	// Allocated without holding the lock. fb::init only reallocates when
+	// a buffer grows, so sizing it to the class here keeps later frames up
+	// to that size in the same memory.
+	frame.image = new ctl::dpx::fb<float>();
+	frame.capacity = 0;
+	if (size > 0)
+	{
+		frame.image->init(size, 1, 1);
+		frame.capacity = size;
+		advise_huge_pages(frame.image->ptr(), size);
+	}
+	frame.busy = true;
+
+	IlmThread::Lock lock(_mutex);
+	frame.used = ++_clock;
+	_frames.push_back(frame);
+	return frame.image;
+}
+
+void BufferPool::release(ctl::dpx::fb<float> *image_buffer)
+{
+	IlmThread::Lock lock(_mutex);
+	size_t i = 0;
+
+	while (i < _frames.size() && _frames[i].image != image_buffer)
+	{
+		i++;
+	}
+	if (i == _frames.size())
+	{
+		// Not one of ours, it is kept all the same.
+		frame_t frame;
+		frame.image = image_buffer;
+		frame.capacity = 0;
+		_frames.push_back(frame);
+	}
+
+	frame_t &frame = _frames[i];
+	uint64_t count = frame_count(*image_buffer);
+	if (count > frame.capacity)
+	{
+		// Grown by the reader, which knew the size.
+		frame.capacity = count;
+		advise_huge_pages(image_buffer->ptr(), count);
+	}
+	frame.busy = false;
+	frame.used = ++_clock;
+	trim();
+}
+
+CTLResultPtr BufferPool::acquire_channel(const std::string &name, size_t count)
+{
+	uint64_t size = size_class(count);
+	channel_t channel;
+
+	{
+		IlmThread::Lock lock(_mutex);
+		int best = -1;
+
+		// Only the pool refers to an idle channel, so nothing else can
+		// take it while the lock is held.
+		for (size_t i = 0; i < _channels.size(); i++)
+		{
+			const channel_t &c = _channels[i];
+			if (c.result.refcount() == 1 && c.name == name && c.capacity >= count && c.capacity <= 2 * size &&
+			    (best < 0 || c.used > _channels[best].used))
+			{
+				best = i;
+			}
+		}
+		if (best >= 0)
+		{
+			_channels[best].used = ++_clock;
+			_channels[best].result->varying = true;
+			_hits++;
+			return _channels[best].result;
+		}
+		_misses++;
+	}
+
+	channel.result = new CTLResult();
+	channel.result->data = new Ctl::DataArg(name, new Ctl::StdFloatType(), size);
+	channel.result->varying = true;
+	channel.name = name;
+	channel.capacity = size;
+
+	IlmThread::Lock lock(_mutex);
+	channel.used = ++_clock;
+	_channels.push_back(channel);
+	trim();
+	return channel.result;
+}
+
+void BufferPool::release_idle()
+{
+	IlmThread::Lock lock(_mutex);
+	double max_bytes = _max_bytes;
+
+	_max_bytes = 0.0;
+	trim();
+	_max_bytes = max_bytes;
+}
+
+size_t BufferPool::hits()
+{
+	IlmThread::Lock lock(_mutex);
+	return _hits;
+}
+
+size_t BufferPool::misses()
+{
+	IlmThread::Lock lock(_mutex);
+	return _misses;
+}
+
+double BufferPool::idle_bytes()
+{
+	IlmThread::Lock lock(_mutex);
+	double bytes = 0.0;
+
+	for (size_t i = 0; i < _frames.size(); i++)
+	{
+		bytes += _frames[i].busy ? 0.0 : _frames[i].capacity * sizeof(float);
+	}
+	for (size_t i = 0; i < _channels.size(); i++)
+	{
+		bytes += _channels[i].result.refcount() > 1 ? 0.0 : _channels[i].capacity * sizeof(float);
+	}
+	return bytes;
+}
+
+double BufferPool::busy_bytes()
+{
+	IlmThread::Lock lock(_mutex);
+	double bytes = 0.0;
+
+	for (size_t i = 0; i < _frames.size(); i++)
+	{
+		bytes += _frames[i].busy ? _frames[i].capacity * sizeof(float) : 0.0;
+	}
+	for (size_t i = 0; i < _channels.size(); i++)
+	{
+		bytes += _channels[i].result.refcount() > 1 ? _channels[i].capacity * sizeof(float) : 0.0;
+	}
+	return bytes;
+}
+
+// Frees idle buffers and channels, least recently used first, until the
+// idle ones fit in _max_bytes. The lock must be held.
+void BufferPool::trim()
+{
+	for (;;)
+	{
+		double bytes = 0.0;
+		int frame = -1;
+		int channel = -1;
+		uint64_t oldest = ~(uint64_t) 0;
+
+		for (size_t i = 0; i < _frames.size(); i++)
+		{
+			if (!_frames[i].busy)
+			{
+				bytes += _frames[i].capacity * sizeof(float);
+				if (_frames[i].used < oldest)
+				{
+					oldest = _frames[i].used;
+					frame = i;
+				}
+			}
+		}
+		for (size_t i = 0; i < _channels.size(); i++)
+		{
+			if (_channels[i].result.refcount() == 1)
+			{
+				bytes += _channels[i].capacity * sizeof(float);
+				if (_channels[i].used < oldest)
+				{
+					oldest = _channels[i].used;
+					channel = i;
+					frame = -1;
+				}
+			}
+		}
+		if (bytes <= _max_bytes || (frame < 0 && channel < 0))
+		{
+			return;
+		}
+		if (frame >= 0)
+		{
+			delete _frames[frame].image;
+			_frames.erase(_frames.begin() + frame);
+		}
+		else
+		{
+			_channels.erase(_channels.begin() + channel);
+		}
+	}
+}
+
+BufferPool &buffer_pool()
+{
+	static BufferPool pool(2048e6);
+	return pool;
+}
+
+PooledFrame::PooledFrame(uint64_t count)
+	: _image(buffer_pool().acquire(count))
+{
+}
+
+PooledFrame::~PooledFrame()
+{
+	buffer_pool().release(_image);
+}
+
+ctl::dpx::fb<float> *PooledFrame::get() const
+{
+	return _image;
+}
@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_BUFFER_POOL_INCLUDE)
+#define CTL_UTIL_CTLRENDER_BUFFER_POOL_INCLUDE
+
+#include "transform.hh"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <IlmThreadMutex.h>
+
+// Frame buffers and CTL channels kept from one frame to the next, and from
+// one call to the next, rather than freed and allocated again for every
+// frame. Sizes are rounded up to a size class (a power of two, or a whole
+// number of 2 MB huge pages for large buffers), and a request is met by an
+// idle buffer of at least its class but not more than twice it. Large
+// buffers are advised to use transparent huge pages where the system has
+// them. Idle buffers beyond max_bytes are freed, least recently used
+// first; buffers in use do not count. Safe to use from several threads.
+class BufferPool
+{
+	public:
+		BufferPool(double max_bytes);
+		~BufferPool();
+
+		void set_max_bytes(double max_bytes);
+		double max_bytes();
+
+		// A frame buffer that holds at least count floats without
+		// growing. With a count of 0, as when the size is only known once
+		// the file is read, the idle buffer given back last: the frames of
+		// a batch are the same size, so it usually holds the next one.
+		ctl::dpx::fb<float> *acquire(uint64_t count = 0);
+		void release(ctl::dpx::fb<float> *image_buffer);
+
+		// A varying float channel named name of at least count samples.
+		// It is idle again once no CTLResultPtr other than the pool's
+		// refers to it.
+		CTLResultPtr acquire_channel(const std::string &name, size_t count);
+
+		// Frees every idle buffer and channel.
+		void release_idle();
+
+		// Requests met by an idle buffer or channel, and those that
+		// allocated one, since the pool was made.
+		size_t hits();
+		size_t misses();
+
+		// Held by idle buffers and channels, and by those in use.
+		double idle_bytes();
+		double busy_bytes();
+
+	private:
+		struct frame_t
+		{
+			ctl::dpx::fb<float> *image;
+			uint64_t capacity;
+			uint64_t used;
+			bool busy;
+		};
+		struct channel_t
+		{
+			CTLResultPtr result;
+			std::string name;
+			size_t capacity;
+			uint64_t used;
+		};
+
+		void trim();
+
+		double _max_bytes;
+		IlmThread::Mutex _mutex;
+		std::vector<frame_t> _frames;
+		std::vector<channel_t> _channels;
+		uint64_t _clock;
+		size_t _hits;
+		size_t _misses;
+};
+
+// The pool every transform in the process takes its buffers from. Its
+// default size is 2048 MB.
+BufferPool &buffer_pool();
+
+// A frame buffer from buffer_pool() for as long as the object lives.
+class PooledFrame
+{
+	public:
+		PooledFrame(uint64_t count = 0);
+		~PooledFrame();
+
+		ctl::dpx::fb<float> *get() const;
+
+	private:
+		PooledFrame(const PooledFrame &);
+		PooledFrame &operator=(const PooledFrame &);
+
+		ctl::dpx::fb<float> *_image;
+};
+
+#endif
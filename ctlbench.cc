@@ -0,0 +1,1255 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+// ctlbench - times the ctl transform pipeline without MATLAB.
+//
+// Synthetic frames are written in every requested format, then read,
+// evaluated and written again by the same code the mex file links, and the
+// throughput of each stage is reported as JSON.
+
+#include "transform.hh"
+#include "batch.hh"
+#include "tiff_convert.hh"
+#include "half_convert.hh"
+#include "dpx_convert.hh"
+#include "render_cache.hh"
+#include "buffer_pool.hh"
+#include "sequence.hh"
+#include "aces_file.hh"
+#include <Iex.h>
+#include <ImfInputFile.h>
+#include <ImfHeader.h>
+#include <ImfChannelList.h>
+#include <ImfIntAttribute.h>
+#include <ImfStandardAttributes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <exception>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+int verbosity = 0;
+
+// Canned chains. 'aces' has the shape of an ACES output transform: into a
+// working space, a tone scale, then out to a display encoding.
+static const char ctl_identity[] =
+"void main(input varying float rIn, input varying float gIn, input varying float bIn,\n"
+"          input varying float aIn = 1.0,\n"
+"          output varying float rOut, output varying float gOut, output varying float bOut,\n"
+"          output varying float aOut)\n"
+"{\n"
+"    rOut = rIn; gOut = gIn; bOut = bIn; aOut = aIn;\n"
+"}\n";
+
+static const char ctl_matrix[] =
+"void main(input varying float rIn, input varying float gIn, input varying float bIn,\n"
+"          input varying float aIn = 1.0,\n"
+"          output varying float rOut, output varying float gOut, output varying float bOut,\n"
+"          output varying float aOut)\n"
+"{\n"
+"    rOut =  0.6954522 * rIn + 0.1406787 * gIn + 0.1638690 * bIn;\n"
+"    gOut =  0.0447946 * rIn + 0.8596711 * gIn + 0.0955343 * bIn;\n"
+"    bOut = -0.0055259 * rIn + 0.0040252 * gIn + 1.0015007 * bIn;\n"
+"    aOut = aIn;\n"
+"}\n";
+
+static const char ctl_tone[] =
+"float tone(float x)\n"
+"{\n"
+"    if (x <= 0.0)\n"
+"        return 0.0;\n"
+"    float s = pow(10.0, 0.9 * log10(x) + 0.2);\n"
+"    return s / (s + 1.0);\n"
+"}\n"
+"\n"
+"void main(input varying float rIn, input varying float gIn, input varying float bIn,\n"
+"          input varying float aIn = 1.0,\n"
+"          output varying float rOut, output varying float gOut, output varying float bOut,\n"
+"          output varying float aOut)\n"
+"{\n"
+"    rOut = tone(rIn); gOut = tone(gIn); bOut = tone(bIn); aOut = aIn;\n"
+"}\n";
+
+static const char ctl_display[] =
+"float encode(float x)\n"
+"{\n"
+"    if (x <= 0.0)\n"
+"        return 0.0;\n"
+"    if (x >= 1.0)\n"
+"        return 1.0;\n"
+"    return pow(x, 1.0 / 2.4);\n"
+"}\n"
+"\n"
+"void main(input varying float rIn, input varying float gIn, input varying float bIn,\n"
+"          input varying float aIn = 1.0,\n"
+"          output varying float rOut, output varying float gOut, output varying float bOut,\n"
+"          output varying float aOut)\n"
+"{\n"
+"    rOut = encode( 1.6410234 * rIn - 0.3248033 * gIn - 0.2364247 * bIn);\n"
+"    gOut = encode(-0.6636629 * rIn + 1.6153316 * gIn + 0.0167563 * bIn);\n"
+"    bOut = encode( 0.0117219 * rIn - 0.0082844 * gIn + 0.9883949 * bIn);\n"
+"    aOut = aIn;\n"
+"}\n";
+
+struct canned_ctl_t
+{
+	const char *name;
+	const char *source;
+};
+
+struct canned_chain_t
+{
+	const char *name;
+	canned_ctl_t stages[4];
+};
+
+static const canned_chain_t canned_chains[] =
+{
+	{ "identity", { { "identity", ctl_identity }, { NULL, NULL } } },
+	{ "matrix",   { { "matrix", ctl_matrix }, { NULL, NULL } } },
+	{ "aces",     { { "matrix", ctl_matrix }, { "tone", ctl_tone }, { "display", ctl_display }, { NULL, NULL } } },
+	{ NULL,       { { NULL, NULL } } }
+};
+
+struct bench_format_t
+{
+	std::string name;
+	format_t format;
+};
+
+struct bench_result_t
+{
+	std::string format;
+	std::string stage;
+	double seconds;
+	double pixels;
+	double bytes;
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static double file_size(const std::string &name)
+{
+	struct stat file_status;
+	return stat(name.c_str(), &file_status) < 0 ? 0.0 : (double) file_status.st_size;
+}
+
+static void bench_usage()
+{
+	fprintf(stderr, ""
+"ctlbench - times reading, ctl evaluation and writing of synthetic frames\n"
+"\n"
+"usage:\n"
+"    ctlbench [<options> ...]\n"
+"\n"
+"options:\n"
+"    -size <w>x<h>         Frame size, 1920x1080 by default.\n"
+"    -formats <list>       Comma separated formats to time, from exr16,\n"
+"                          exr32, tif8, tif16, tif32, dpx8, dpx10, dpx12 and\n"
+"                          dpx16. Default exr16,tif16,dpx10.\n"
+"    -alpha                Frames have an alpha channel.\n"
+"    -noalpha              Outputs leave alpha out, as ctl -noalpha does,\n"
+"                          so that the alpha of -alpha frames is neither\n"
+"                          decoded (exr) nor handed to the scripts.\n"
+"    -frames <count>       Frames per format, 4 by default.\n"
+"    -chain <name>         Canned ctl chain: identity, matrix or aces (the\n"
+"                          default, three scripts).\n"
+"    -ctl <filename>       A ctl script to time instead of a canned chain.\n"
+"                          May be repeated to make a chain.\n"
+"    -threads <count>      Thread budget shared by ctl evaluation and the\n"
+"                          OpenEXR codecs, 0 (the default) for one per\n"
+"                          processor.\n"
+"    -inflight <count>     Frames in flight for the batch stage, 3 by\n"
+"                          default.\n"
+"    -read_ahead <count>   Frames the batch stage decodes ahead of the one\n"
+"                          being added, 2 by default.\n"
+"    -strip_rows <rows>    Scanlines per strip for the pipeline stages, 0\n"
+"                          (the default) for whole frames.\n"
+"    -tile <size>          Writes exr frames as square tiles of this size,\n"
+"                          0 (the default) for scanline files.\n"
+"    -repeat <count>       Each stage is run this many times and the\n"
+"                          fastest is reported, 3 by default.\n"
+"    -dir <directory>      Where the frames are written, a new directory\n"
+"                          under /tmp by default. It is removed afterwards\n"
+"                          unless -keep is given.\n"
+"    -keep                 Keeps the frames and scripts.\n"
+"    -o <filename>         Writes the JSON report there rather than to\n"
+"                          stdout.\n"
+"    -check                Checks that every vector sample conversion this\n"
+"                          processor runs (tiff, dpx and float to half)\n"
+"                          matches the scalar one bit for bit and that every\n"
+"                          10 and 12 bit dpx code survives a round trip,\n"
+"                          that the render cache keeps, finds and evicts\n"
+"                          files as it should, that the buffer pool hands\n"
+"                          idle buffers out again, that sequence patterns\n"
+"                          name frames as they should and that ACES files\n"
+"                          get the container header aces_write gives them,\n"
+"                          then exits.\n"
+"                          Nothing is timed.\n"
+"\n"
+"stages, each reported with seconds, Mpix/s and MB/s:\n"
+"    write      write_image of every frame (this also makes the inputs).\n"
+"    read       read_image of every frame. MB/s is of file bytes.\n"
+"    evaluate   transform_buffer of one decoded frame. MB/s counts the\n"
+"               float samples going in and coming out.\n"
+"    transform  transform() file to file, one frame at a time. MB/s counts\n"
+"               the file bytes read and written.\n"
+"    batch      The same through a Batch with -inflight frames in flight\n"
+"               and -read_ahead frames read ahead.\n"
+"");
+}
+
+static int parse_int(const char *arg, const char *option, int minimum)
+{
+	char *end = NULL;
+	long value = strtol(arg, &end, 10);
+
+	if ((end != NULL && *end != 0) || value < minimum)
+	{
+		fprintf(stderr, "Unable to parse '%s' for the '%s' argument\n", arg, option);
+		exit(1);
+	}
+	return (int) value;
+}
+
+static bool parse_format(const std::string &name, bench_format_t *format)
+{
+	static const char *exts[] = { "exr", "tif", "dpx", NULL };
+	static const int bits[] = { 8, 10, 12, 16, 32, 0 };
+
+	for (int e = 0; exts[e] != NULL; e++)
+	{
+		for (int b = 0; bits[b] != 0; b++)
+		{
+			char candidate[16];
+			snprintf(candidate, sizeof(candidate), "%s%d", exts[e], bits[b]);
+			if (name == candidate)
+			{
+				format->name = name;
+				format->format = format_t(exts[e], bits[b]);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Smooth ramps in R and G and a coarse pattern in B, so that compressed
+// formats have some work to do but do not collapse to nothing.
+static void fill_frame(ctl::dpx::fb<float> *image_buffer, uint32_t width, uint32_t height, uint32_t depth, int frame)
+{
+	image_buffer->init(width, height, depth);
+	float *p = image_buffer->ptr();
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++, p += depth)
+		{
+			p[0] = (float) x / width;
+			p[1] = (float) y / height;
+			p[2] = (((x >> 3) ^ (y >> 3) ^ frame) & 255) / 255.0;
+			if (depth > 3)
+			{
+				p[3] = 1.0;
+			}
+		}
+	}
+}
+
+static void copy_frame(const ctl::dpx::fb<float> &from, ctl::dpx::fb<float> *to)
+{
+	to->init(from.width(), from.height(), from.depth());
+	memcpy(to->ptr(), from.ptr(), from.pixels() * from.depth() * sizeof(float));
+}
+
+static void add_result(std::vector<bench_result_t> *results, const std::string &format, const char *stage,
+                       double seconds, double pixels, double bytes)
+{
+	bench_result_t result;
+
+	result.format = format;
+	result.stage = stage;
+	result.seconds = seconds;
+	result.pixels = pixels;
+	result.bytes = bytes;
+	results->push_back(result);
+
+	fprintf(stderr, "%8s %-10s %9.4f s %9.2f Mpix/s %9.2f MB/s\n", format.c_str(), stage, seconds,
+	        pixels / seconds / 1e6, bytes / seconds / 1e6);
+}
+
+static std::string json_string(const std::string &s)
+{
+	std::string quoted = "\"";
+
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		if (s[i] == '"' || s[i] == '\\')
+		{
+			quoted += '\\';
+		}
+		quoted += s[i];
+	}
+	return quoted + "\"";
+}
+
+static float float_bits(uint32_t bits)
+{
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+// Samples that exercise the clipping and rounding: a sweep through every
+// binade of both signs, each integer code value with the halfway point
+// and its neighbours for the scales in use, infinities and NaN.
+static std::vector<float> check_samples()
+{
+	std::vector<float> samples;
+
+	for (uint64_t bits = 0; bits <= 0xffffffffULL; bits += 4093)
+	{
+		samples.push_back(float_bits((uint32_t) bits));
+	}
+	for (int code = 0; code <= 65536; code++)
+	{
+		float half = code + 0.5f;
+		uint32_t bits;
+		memcpy(&bits, &half, sizeof(bits));
+		samples.push_back(code / 255.0f);
+		samples.push_back(code / 65535.0f);
+		samples.push_back((float) code);
+		samples.push_back(half);
+		samples.push_back(float_bits(bits - 1));
+		samples.push_back(float_bits(bits + 1));
+		samples.push_back(half / 255.0f);
+		samples.push_back(half / 65535.0f);
+	}
+	samples.push_back(float_bits(0x7f800000));
+	samples.push_back(float_bits(0xff800000));
+	samples.push_back(float_bits(0x7fc00000));
+	samples.push_back(float_bits(0xffc00001));
+	samples.push_back(float_bits(0x80000000));
+	return samples;
+}
+
+template <class T>
+static bool same_bits(const std::vector<T> &a, const std::vector<T> &b)
+{
+	return a.size() == b.size() && memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0;
+}
+
+// Runs one set of kernels against the scalar set over every sample, at
+// several starting offsets so that each vector loop also ends in a tail.
+static int check_tiff_kernels(const tiff_kernels_t &reference, const tiff_kernels_t &kernels, const std::vector<float> &samples)
+{
+	static const float scales[] = { 1.0f, 255.0f, 65535.0f, 1.0f / 255.0f, 1.0f / 65535.0f, 1023.0f };
+	int failures = 0;
+
+	for (size_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++)
+	{
+		for (size_t offset = 0; offset < 64; offset += 13)
+		{
+			const float *in = &samples[offset];
+			size_t count = samples.size() - offset;
+			float scale = scales[s];
+			std::vector<uint8_t> expected8(count), actual8(count);
+			std::vector<uint16_t> expected16(count), actual16(count);
+			std::vector<float> expected(count), actual(count);
+			const char *failed = NULL;
+
+			reference.interleave_uint8(in, count, scale, &expected8[0]);
+			kernels.interleave_uint8(in, count, scale, &actual8[0]);
+			if (!same_bits(expected8, actual8))
+			{
+				failed = "interleave_uint8";
+			}
+			reference.interleave_uint16(in, count, scale, &expected16[0]);
+			kernels.interleave_uint16(in, count, scale, &actual16[0]);
+			if (!same_bits(expected16, actual16))
+			{
+				failed = "interleave_uint16";
+			}
+			reference.scale_float(in, count, scale, &expected[0]);
+			kernels.scale_float(in, count, scale, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "scale_float";
+			}
+			reference.convert_uint8(&expected8[0], count, scale, &expected[0]);
+			kernels.convert_uint8(&expected8[0], count, scale, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "convert_uint8";
+			}
+			reference.convert_uint16(&expected16[0], count, scale, &expected[0]);
+			kernels.convert_uint16(&expected16[0], count, scale, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "convert_uint16";
+			}
+
+			if (failed != NULL)
+			{
+				fprintf(stderr, "%8s %s differs from scalar (scale %g, offset %d)\n", kernels.name, failed, scale, (int) offset);
+				failures++;
+			}
+		}
+	}
+	return failures;
+}
+
+// Adds each half value's neighbourhood, the float halfway to the next
+// half and the floats either side of it where the rounding decides, and
+// NaNs with payloads in both the kept and the dropped bits.
+static int check_half_kernel(const half_kernel_t &reference, const half_kernel_t &kernel, const std::vector<float> &samples)
+{
+	static const float divisors[] = { 1.0f, 3.0f, 0.1f, 255.0f };
+	std::vector<float> in(samples);
+	int failures = 0;
+
+	for (uint32_t h = 0; h < 0x10000; h++)
+	{
+		uint32_t sign = (h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+		if (exponent == 0 || exponent == 0x1f)
+		{
+			continue;
+		}
+		uint32_t bits = sign | ((exponent + 112) << 23) | (mantissa << 13) | 0x1000;
+		in.push_back(float_bits(bits - 1));
+		in.push_back(float_bits(bits));
+		in.push_back(float_bits(bits + 1));
+	}
+	for (uint32_t payload = 1; payload < 0x800000; payload = payload * 3 + 1)
+	{
+		in.push_back(float_bits(0x7f800000 | payload));
+		in.push_back(float_bits(0xff800000 | payload));
+	}
+
+	for (size_t d = 0; d < sizeof(divisors) / sizeof(divisors[0]); d++)
+	{
+		for (size_t offset = 0; offset < 16; offset += 5)
+		{
+			size_t count = in.size() - offset;
+			std::vector<half> expected(count), actual(count);
+
+			reference.float_to_half(&in[offset], count, divisors[d], &expected[0]);
+			kernel.float_to_half(&in[offset], count, divisors[d], &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				fprintf(stderr, "%8s float_to_half differs from half(float) (divisor %g, offset %d)\n", kernel.name, divisors[d], (int) offset);
+				failures++;
+			}
+		}
+	}
+	return failures;
+}
+
+// Packs the samples with both byte orders and filling methods, then
+// unpacks what was packed and also the raw bytes of the samples, which
+// puts arbitrary bits in the unused ones. Every code value is unpacked,
+// packed again and compared with the bytes it came from.
+static int check_dpx_kernels(const dpx_kernels_t &reference, const dpx_kernels_t &kernels, const std::vector<float> &samples)
+{
+	int failures = 0;
+
+	for (int order = 0; order < 4; order++)
+	{
+		bool swap = (order & 1) != 0;
+		bool method_a = (order & 2) != 0;
+
+		for (size_t offset = 0; offset < 64; offset += 13)
+		{
+			const float *in = &samples[offset];
+			size_t count = samples.size() - offset;
+			std::vector<uint8_t> expected10((count + 2) / 3 * 4), actual10(expected10.size());
+			std::vector<uint8_t> expected12(count * 2), actual12(count * 2);
+			std::vector<float> expected(count), actual(count);
+			const char *failed = NULL;
+
+			reference.pack10(in, count, swap, method_a, 1023.0f, &expected10[0]);
+			kernels.pack10(in, count, swap, method_a, 1023.0f, &actual10[0]);
+			if (!same_bits(expected10, actual10))
+			{
+				failed = "pack10";
+			}
+			reference.pack12(in, count, swap, method_a, 4095.0f, &expected12[0]);
+			kernels.pack12(in, count, swap, method_a, 4095.0f, &actual12[0]);
+			if (!same_bits(expected12, actual12))
+			{
+				failed = "pack12";
+			}
+			reference.unpack10(&expected10[0], count, swap, method_a, 1.0f / 1023.0f, &expected[0]);
+			kernels.unpack10(&expected10[0], count, swap, method_a, 1.0f / 1023.0f, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "unpack10";
+			}
+			reference.unpack12(&expected12[0], count, swap, method_a, 1.0f / 4095.0f, &expected[0]);
+			kernels.unpack12(&expected12[0], count, swap, method_a, 1.0f / 4095.0f, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "unpack12";
+			}
+			reference.unpack10((const uint8_t *) in, count, swap, method_a, 1.0f, &expected[0]);
+			kernels.unpack10((const uint8_t *) in, count, swap, method_a, 1.0f, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "unpack10";
+			}
+			reference.unpack12((const uint8_t *) in, count, swap, method_a, 1.0f, &expected[0]);
+			kernels.unpack12((const uint8_t *) in, count, swap, method_a, 1.0f, &actual[0]);
+			if (!same_bits(expected, actual))
+			{
+				failed = "unpack12";
+			}
+
+			if (failed != NULL)
+			{
+				fprintf(stderr, "%8s %s differs from scalar (%s, method %c, offset %d)\n", kernels.name, failed,
+				        swap ? "swapped" : "native", method_a ? 'A' : 'B', (int) offset);
+				failures++;
+			}
+		}
+
+		std::vector<float> codes(4096);
+		for (size_t code = 0; code < codes.size(); code++)
+		{
+			codes[code] = (float) code;
+		}
+		std::vector<uint8_t> packed10(1024 / 3 * 4 + 4), repacked10(packed10.size());
+		std::vector<uint8_t> packed12(4096 * 2), repacked12(packed12.size());
+		std::vector<float> decoded(4096);
+
+		kernels.pack10(&codes[0], 1024, swap, method_a, 1.0f, &packed10[0]);
+		kernels.unpack10(&packed10[0], 1024, swap, method_a, 1.0f / 1023.0f, &decoded[0]);
+		kernels.pack10(&decoded[0], 1024, swap, method_a, 1023.0f, &repacked10[0]);
+		if (!same_bits(packed10, repacked10))
+		{
+			fprintf(stderr, "%8s 10 bit codes change in a round trip (%s, method %c)\n", kernels.name,
+			        swap ? "swapped" : "native", method_a ? 'A' : 'B');
+			failures++;
+		}
+		kernels.pack12(&codes[0], 4096, swap, method_a, 1.0f, &packed12[0]);
+		kernels.unpack12(&packed12[0], 4096, swap, method_a, 1.0f / 4095.0f, &decoded[0]);
+		kernels.pack12(&decoded[0], 4096, swap, method_a, 4095.0f, &repacked12[0]);
+		if (!same_bits(packed12, repacked12))
+		{
+			fprintf(stderr, "%8s 12 bit codes change in a round trip (%s, method %c)\n", kernels.name,
+			        swap ? "swapped" : "native", method_a ? 'A' : 'B');
+			failures++;
+		}
+	}
+	return failures;
+}
+
+static int check_kernels()
+{
+	static const tiff_isa_t isas[] = { TIFF_ISA_SSE41, TIFF_ISA_AVX2, TIFF_ISA_AVX512 };
+	static const char *isa_names[] = { "sse4.1", "avx2", "avx512" };
+	const tiff_kernels_t &scalar = *tiff_kernels_for(TIFF_ISA_SCALAR);
+	std::vector<float> samples = check_samples();
+	int failures = 0;
+
+	for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++)
+	{
+		const tiff_kernels_t *kernels = tiff_kernels_for(isas[i]);
+		if (kernels == NULL)
+		{
+			fprintf(stderr, "%8s not supported here, skipped\n", isa_names[i]);
+			continue;
+		}
+		int failed = check_tiff_kernels(scalar, *kernels, samples);
+		fprintf(stderr, "%8s tiff conversions %s\n", kernels->name, failed == 0 ? "match" : "DIFFER");
+		failures += failed;
+	}
+	fprintf(stderr, "tiff conversions use %s\n", tiff_kernels().name);
+
+	static const dpx_isa_t dpx_isas[] = { DPX_ISA_SCALAR, DPX_ISA_SSSE3, DPX_ISA_AVX2 };
+	static const char *dpx_isa_names[] = { "scalar", "ssse3", "avx2" };
+	const dpx_kernels_t &dpx_scalar = *dpx_kernels_for(DPX_ISA_SCALAR);
+
+	for (size_t i = 0; i < sizeof(dpx_isas) / sizeof(dpx_isas[0]); i++)
+	{
+		const dpx_kernels_t *kernels = dpx_kernels_for(dpx_isas[i]);
+		if (kernels == NULL)
+		{
+			fprintf(stderr, "%8s not supported here, skipped\n", dpx_isa_names[i]);
+			continue;
+		}
+		int failed = check_dpx_kernels(dpx_scalar, *kernels, samples);
+		fprintf(stderr, "%8s dpx conversions %s\n", kernels->name, failed == 0 ? "match" : "DIFFER");
+		failures += failed;
+	}
+	fprintf(stderr, "dpx conversions use %s\n", dpx_kernels().name);
+
+	const half_kernel_t *f16c = half_kernel_for(HALF_ISA_F16C);
+	if (f16c == NULL)
+	{
+		fprintf(stderr, "%8s not supported here, skipped\n", "f16c");
+	}
+	else
+	{
+		int failed = check_half_kernel(*half_kernel_for(HALF_ISA_TABLE), *f16c, samples);
+		fprintf(stderr, "%8s half conversion %s\n", f16c->name, failed == 0 ? "matches" : "DIFFERS");
+		failures += failed;
+	}
+	fprintf(stderr, "half conversion uses %s\n", half_kernel().name);
+	return failures == 0 ? 0 : 1;
+}
+
+static bool write_check_file(const std::string &name, char fill)
+{
+	std::vector<char> bytes(1000, fill);
+	FILE *file = fopen(name.c_str(), "wb");
+
+	return file != NULL && fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size() && fclose(file) == 0;
+}
+
+static bool check_file_holds(const std::string &name, char fill)
+{
+	std::vector<char> bytes(1001, 0);
+	FILE *file = fopen(name.c_str(), "rb");
+
+	if (file == NULL)
+	{
+		return false;
+	}
+	size_t n = fread(&bytes[0], 1, bytes.size(), file);
+	fclose(file);
+	return n == 1000 && std::count(bytes.begin(), bytes.begin() + n, fill) == 1000;
+}
+
+// Three 1000 byte files through a 2500 byte cache in a scratch directory:
+// storing the third evicts whichever of the first two was used least
+// recently.
+static int check_render_cache()
+{
+	char temp[] = "/tmp/ctlbench.XXXXXX";
+	int failures = 0;
+
+	if (mkdtemp(temp) == NULL)
+	{
+		fprintf(stderr, "Unable to create a directory for the cache (%s)\n", strerror(errno));
+		return 1;
+	}
+	std::string dir = temp;
+	std::string keys[3];
+	std::string outputs[3];
+
+	for (int i = 0; i < 3; i++)
+	{
+		RenderHash hash;
+		hash.add((double) i);
+		keys[i] = hash.key();
+		outputs[i] = dir + "/out" + (char) ('0' + i) + ".exr";
+		if (!write_check_file(outputs[i], 'a' + i))
+		{
+			fprintf(stderr, "Unable to write %s (%s)\n", outputs[i].c_str(), strerror(errno));
+			return 1;
+		}
+	}
+
+	RenderHash ab_c;
+	RenderHash a_bc;
+	ab_c.add(std::string("ab"));
+	ab_c.add(std::string("c"));
+	a_bc.add(std::string("a"));
+	a_bc.add(std::string("bc"));
+	failures += ab_c.key() == a_bc.key() || keys[0] == keys[1];
+
+	try
+	{
+		RenderCache cache(dir + "/cache", 2500);
+		std::string fetched = dir + "/fetched.exr";
+
+		cache.store(keys[0], outputs[0].c_str());
+		cache.store(keys[1], outputs[1].c_str());
+		failures += !cache.fetch(keys[0], fetched.c_str()) || !check_file_holds(fetched, 'a');
+		unlink(fetched.c_str());
+		failures += cache.fetch(keys[2], fetched.c_str());
+		cache.store(keys[2], outputs[2].c_str());
+		failures += cache.entries() != 2 || cache.evictions() != 1;
+		failures += cache.fetch(keys[1], fetched.c_str());
+		failures += !cache.fetch(keys[2], fetched.c_str()) || !check_file_holds(fetched, 'c');
+		unlink(fetched.c_str());
+		failures += cache.hits() != 2 || cache.misses() != 2 || cache.stores() != 3;
+
+		for (int i = 0; i < 3; i++)
+		{
+			unlink((dir + "/cache/" + keys[i] + ".exr").c_str());
+			unlink(outputs[i].c_str());
+		}
+		rmdir((dir + "/cache").c_str());
+	}
+	catch (std::exception &e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		failures++;
+	}
+	rmdir(dir.c_str());
+
+	fprintf(stderr, "render cache %s\n", failures == 0 ? "works" : "FAILS");
+	return failures == 0 ? 0 : 1;
+}
+
+static int check_buffer_pool()
+{
+	BufferPool pool(64e6);
+	int failures = 0;
+
+	// Buffers of the same size class are handed out again, larger ones
+	// are kept for larger requests.
+	ctl::dpx::fb<float> *a = pool.acquire(1000000);
+	ctl::dpx::fb<float> *b = pool.acquire(1000000);
+	failures += a == b;
+	pool.release(a);
+	failures += pool.acquire(900000) != a;
+	pool.release(b);
+	ctl::dpx::fb<float> *c = pool.acquire(1000);
+	failures += c == b;
+	pool.release(c);
+	failures += pool.acquire() != c;
+	pool.release(c);
+	pool.release(a);
+	failures += pool.hits() != 2 || pool.misses() != 3;
+
+	// A channel is idle once nothing else refers to it, and only goes to
+	// a channel of the same name.
+	CTLResultPtr r = pool.acquire_channel("R", 1000000);
+	CTLResultPtr s = pool.acquire_channel("R", 1000000);
+	CTLResult *first = r.pointer();
+	failures += s.pointer() == first;
+	r = CTLResultPtr();
+	failures += pool.acquire_channel("G", 1000000).pointer() == first;
+	r = pool.acquire_channel("R", 1000000);
+	failures += r.pointer() != first;
+
+	pool.set_max_bytes(0.0);
+	failures += pool.idle_bytes() != 0.0 || pool.busy_bytes() < 4e6;
+
+	fprintf(stderr, "buffer pool %s\n", failures == 0 ? "works" : "FAILS");
+	return failures == 0 ? 0 : 1;
+}
+
+// Patterns name their frames, and ones padded beyond what a frame number
+// can fill are refused rather than overrunning the name.
+static int check_sequences()
+{
+	sequence_t sequence;
+	int failures = 0;
+
+	failures += !parse_sequence_pattern("plate.%06d.dpx", &sequence) || !parse_frame_ranges("1-5x2,1001", &sequence);
+	failures += sequence_length(sequence) != 4 || sequence_file(sequence, 1) != "plate.000003.dpx" ||
+	            sequence_file(sequence, 3) != "plate.001001.dpx";
+	sequence = sequence_t();
+	failures += !parse_sequence_pattern("plate.####.exr", &sequence) || !parse_frame_ranges("7", &sequence) ||
+	            sequence_file(sequence, 0) != "plate.0007.exr";
+	failures += parse_sequence_pattern("plate.%040d.dpx", &sequence);
+	failures += parse_sequence_pattern(("plate." + std::string(40, '#') + ".dpx").c_str(), &sequence);
+	failures += parse_sequence_pattern("plate.dpx", &sequence);
+
+	fprintf(stderr, "sequence patterns %s\n", failures == 0 ? "work" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
+
+// The fields of an ACES container header (SMPTE ST 2065-4), as text.
+static std::string aces_header(const std::string &name)
+{
+	Imf::InputFile file(name.c_str());
+	const Imf::Header &header = file.header();
+	const Imf::IntAttribute *flag = header.findTypedAttribute<Imf::IntAttribute>("acesImageContainerFlag");
+	std::string text;
+	char field[256];
+
+	snprintf(field, sizeof(field), "acesImageContainerFlag %d\n", flag != NULL ? flag->value() : -1);
+	text += field;
+	if (Imf::hasAdoptedNeutral(header))
+	{
+		const Imath::V2f &neutral = Imf::adoptedNeutral(header);
+		snprintf(field, sizeof(field), "adoptedNeutral %g %g\n", neutral.x, neutral.y);
+		text += field;
+	}
+	if (Imf::hasChromaticities(header))
+	{
+		const Imf::Chromaticities &c = Imf::chromaticities(header);
+		snprintf(field, sizeof(field), "chromaticities %g %g %g %g %g %g %g %g\n", c.red.x, c.red.y, c.green.x, c.green.y,
+		         c.blue.x, c.blue.y, c.white.x, c.white.y);
+		text += field;
+	}
+	snprintf(field, sizeof(field), "compression %d\nlineOrder %d\n", (int) header.compression(), (int) header.lineOrder());
+	text += field;
+	for (Imf::ChannelList::ConstIterator c = header.channels().begin(); c != header.channels().end(); ++c)
+	{
+		snprintf(field, sizeof(field), "channel %s %d\n", c.name(), (int) c.channel().type);
+		text += field;
+	}
+	return text;
+}
+
+// ACES output goes through the streamed exr writer, which puts the
+// container header together itself. It has to match the one ctlrender's
+// aces_write gives the same image, with and without alpha.
+static int check_aces_header()
+{
+	char temp[] = "/tmp/ctlbench.XXXXXX";
+	int failures = 0;
+
+	if (mkdtemp(temp) == NULL)
+	{
+		fprintf(stderr, "Unable to create a directory for the aces files (%s)\n", strerror(errno));
+		return 1;
+	}
+	std::string dir = temp;
+	std::string reference = dir + "/reference.aces";
+	std::string streamed = dir + "/streamed.aces";
+
+	for (uint32_t depth = 3; depth <= 4; depth++)
+	{
+		try
+		{
+			ctl::dpx::fb<float> image_buffer;
+			Compression compression = Compression::compressionNamed("PIZ");
+			format_t reference_format("aces", 16);
+			format_t streamed_format("aces", 16);
+
+			fill_frame(&image_buffer, 64, 48, depth, 0);
+			aces_write(reference.c_str(), 0.0, image_buffer.width(), image_buffer.height(), image_buffer.depth(),
+			           image_buffer.ptr(), &reference_format);
+			write_image(streamed.c_str(), 0.0, image_buffer, &streamed_format, &compression);
+
+			std::string expected = aces_header(reference);
+			std::string written = aces_header(streamed);
+			if (written != expected || written.find("acesImageContainerFlag 1\n") != 0)
+			{
+				fprintf(stderr, "%u channel aces header:\n%swhere aces_write gives:\n%s", depth, written.c_str(), expected.c_str());
+				failures++;
+			}
+		}
+		catch (std::exception &e)
+		{
+			fprintf(stderr, "%s\n", e.what());
+			failures++;
+		}
+		unlink(reference.c_str());
+		unlink(streamed.c_str());
+	}
+	rmdir(dir.c_str());
+
+	fprintf(stderr, "aces header %s\n", failures == 0 ? "matches aces_write" : "DIFFERS");
+	return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, const char **argv)
+{
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t depth = 3;
+	bool noalpha = false;
+	int frames = 4;
+	int repeat = 3;
+	int frames_in_flight = 3;
+	int read_ahead = 2;
+	int threads = 0;
+	transform_options_t options;
+	bool keep = false;
+	std::string chain_name = "aces";
+	std::string formats_list = "exr16,tif16,dpx10";
+	std::string dir;
+	const char *json_file = NULL;
+	std::vector<std::string> ctl_files;
+	std::vector<bench_format_t> formats;
+	std::vector<bench_result_t> results;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (arg == "-size" && has_value)
+		{
+			if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+			{
+				fprintf(stderr, "Unable to parse '%s' as <width>x<height>\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (arg == "-formats" && has_value)
+		{
+			formats_list = argv[++i];
+		}
+		else if (arg == "-alpha")
+		{
+			depth = 4;
+		}
+		else if (arg == "-noalpha")
+		{
+			noalpha = true;
+		}
+		else if (arg == "-frames" && has_value)
+		{
+			frames = parse_int(argv[++i], "-frames", 1);
+		}
+		else if (arg == "-chain" && has_value)
+		{
+			chain_name = argv[++i];
+		}
+		else if (arg == "-ctl" && has_value)
+		{
+			ctl_files.push_back(argv[++i]);
+		}
+		else if (arg == "-threads" && has_value)
+		{
+			threads = parse_int(argv[++i], "-threads", 0);
+		}
+		else if (arg == "-inflight" && has_value)
+		{
+			frames_in_flight = parse_int(argv[++i], "-inflight", 1);
+		}
+		else if (arg == "-read_ahead" && has_value)
+		{
+			read_ahead = parse_int(argv[++i], "-read_ahead", 0);
+		}
+		else if (arg == "-strip_rows" && has_value)
+		{
+			options.strip_rows = parse_int(argv[++i], "-strip_rows", 0);
+		}
+		else if (arg == "-tile" && has_value)
+		{
+			options.tiling.width = options.tiling.height = parse_int(argv[++i], "-tile", 0);
+		}
+		else if (arg == "-repeat" && has_value)
+		{
+			repeat = parse_int(argv[++i], "-repeat", 1);
+		}
+		else if (arg == "-dir" && has_value)
+		{
+			dir = argv[++i];
+		}
+		else if (arg == "-keep")
+		{
+			keep = true;
+		}
+		else if (arg == "-o" && has_value)
+		{
+			json_file = argv[++i];
+		}
+		else if (arg == "-verbose")
+		{
+			verbosity++;
+		}
+		else if (arg == "-check")
+		{
+			return check_kernels() | check_render_cache() | check_buffer_pool() | check_sequences() | check_aces_header();
+		}
+		else
+		{
+			bench_usage();
+			return arg == "-help" ? 0 : 1;
+		}
+	}
+
+	for (size_t start = 0; start <= formats_list.size(); )
+	{
+		size_t comma = formats_list.find(',', start);
+		std::string name = formats_list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+		bench_format_t format;
+
+		if (!parse_format(name, &format))
+		{
+			fprintf(stderr, "Unrecognized format '%s'\n", name.c_str());
+			return 1;
+		}
+		formats.push_back(format);
+		if (comma == std::string::npos)
+		{
+			break;
+		}
+		start = comma + 1;
+	}
+
+	if (dir.empty())
+	{
+		char temp[] = "/tmp/ctlbench.XXXXXX";
+		if (mkdtemp(temp) == NULL)
+		{
+			fprintf(stderr, "Unable to create a directory for the frames (%s)\n", strerror(errno));
+			return 1;
+		}
+		dir = temp;
+	}
+	else if (mkdir(dir.c_str(), 0777) < 0 && errno != EEXIST)
+	{
+		fprintf(stderr, "Unable to create %s (%s)\n", dir.c_str(), strerror(errno));
+		return 1;
+	}
+
+	std::vector<std::string> written;
+
+	try
+	{
+		CTLOperations ctl_operations;
+		CTLParameters global_ctl_parameters;
+		Compression compression = Compression::compressionNamed("PIZ");
+		std::vector<std::string> ctl_names;
+
+		// The canned scripts are written next to the frames.
+		if (ctl_files.empty())
+		{
+			const canned_chain_t *chain = canned_chains;
+			while (chain->name != NULL && chain_name != chain->name)
+			{
+				chain++;
+			}
+			if (chain->name == NULL)
+			{
+				THROW(Iex::ArgExc, "Unrecognized chain '" << chain_name << "'");
+			}
+			for (const canned_ctl_t *stage = chain->stages; stage->name != NULL; stage++)
+			{
+				std::string name = dir + "/" + stage->name + ".ctl";
+				FILE *file = fopen(name.c_str(), "w");
+				if (file == NULL || fputs(stage->source, file) < 0 || fclose(file) != 0)
+				{
+					THROW(Iex::ArgExc, "Unable to write " << name);
+				}
+				ctl_files.push_back(name);
+				written.push_back(name);
+			}
+		}
+		else
+		{
+			chain_name = "custom";
+		}
+		for (size_t i = 0; i < ctl_files.size(); i++)
+		{
+			ctl_operation_t ctl_operation;
+			ctl_operation.filename = ctl_files[i].c_str();
+			ctl_operations.push_back(ctl_operation);
+		}
+
+		double frame_pixels = (double) width * height;
+		double frame_floats = frame_pixels * depth * sizeof(float);
+		options.threads = set_thread_budget(threads, false);
+
+		for (size_t f = 0; f < formats.size(); f++)
+		{
+			const bench_format_t &format = formats[f];
+			format_t output_format = format.format;
+			output_format.squish = noalpha;
+			std::string ext = format.format.ext;
+			std::vector<std::string> inputs, outputs;
+			ctl::dpx::fb<float> image_buffer, decoded, evaluated;
+			double best, input_bytes = 0.0, output_bytes = 0.0;
+
+			for (int n = 0; n < frames; n++)
+			{
+				char name[64];
+				snprintf(name, sizeof(name), "/%s_in.%04d.%s", format.name.c_str(), n, ext.c_str());
+				inputs.push_back(dir + name);
+				snprintf(name, sizeof(name), "/%s_out.%04d.%s", format.name.c_str(), n, ext.c_str());
+				outputs.push_back(dir + name);
+				written.push_back(inputs.back());
+				written.push_back(outputs.back());
+			}
+
+			best = 0.0;
+			for (int r = 0; r < repeat; r++)
+			{
+				double seconds = 0.0;
+				for (int n = 0; n < frames; n++)
+				{
+					format_t frame_format = format.format;
+					fill_frame(&image_buffer, width, height, depth, n);
+					double start = now();
+					write_image(inputs[n].c_str(), 0.0, image_buffer, &frame_format, &compression, options.tiling);
+					seconds += now() - start;
+				}
+				best = r == 0 ? seconds : std::min(best, seconds);
+			}
+			for (int n = 0; n < frames; n++)
+			{
+				input_bytes += file_size(inputs[n]);
+			}
+			add_result(&results, format.name, "write", best, frame_pixels * frames, input_bytes);
+
+			best = 0.0;
+			for (int r = 0; r < repeat; r++)
+			{
+				double start = now();
+				for (int n = 0; n < frames; n++)
+				{
+					format_t image_format;
+					read_image(inputs[n].c_str(), 0.0, &decoded, &image_format, source_alpha_used(ctl_operations, output_format));
+				}
+				best = r == 0 ? now() - start : std::min(best, now() - start);
+			}
+			add_result(&results, format.name, "read", best, frame_pixels * frames, input_bytes);
+
+			best = 0.0;
+			for (int r = 0; r < repeat; r++)
+			{
+				format_t frame_format = output_format;
+				copy_frame(decoded, &evaluated);
+				double start = now();
+				transform_buffer(&evaluated, &frame_format, ctl_operations, global_ctl_parameters, options);
+				best = r == 0 ? now() - start : std::min(best, now() - start);
+			}
+			add_result(&results, format.name, "evaluate", best, frame_pixels, 2.0 * frame_floats);
+
+			best = 0.0;
+			for (int r = 0; r < repeat; r++)
+			{
+				double start = now();
+				for (int n = 0; n < frames; n++)
+				{
+					format_t frame_format = output_format;
+					unlink(outputs[n].c_str());
+					transform(inputs[n].c_str(), outputs[n].c_str(), 0.0, 0.0, &frame_format, &compression, ctl_operations, global_ctl_parameters, options);
+				}
+				best = r == 0 ? now() - start : std::min(best, now() - start);
+			}
+			for (int n = 0; n < frames; n++)
+			{
+				output_bytes += file_size(outputs[n]);
+			}
+			add_result(&results, format.name, "transform", best, frame_pixels * frames, input_bytes + output_bytes);
+
+			transform_options_t batch_options = options;
+			batch_options.threads = set_thread_budget(threads, frames_in_flight > 1 && frames > 1);
+			best = 0.0;
+			for (int r = 0; r < repeat; r++)
+			{
+				for (int n = 0; n < frames; n++)
+				{
+					unlink(outputs[n].c_str());
+				}
+				double start = now();
+				Batch batch(0.0, 0.0, &compression, ctl_operations, global_ctl_parameters, batch_options, frames_in_flight, NULL, read_ahead);
+				int read = 0;
+				for (int n = 0; n < frames; n++)
+				{
+					for (; read < frames && read <= n + read_ahead; read++)
+					{
+						batch.read_ahead(inputs[read].c_str(), output_format);
+					}
+					batch.add(inputs[n].c_str(), outputs[n].c_str(), output_format);
+				}
+				batch.wait();
+				if (batch.failed())
+				{
+					THROW(Iex::BaseExc, batch.error());
+				}
+				best = r == 0 ? now() - start : std::min(best, now() - start);
+			}
+			add_result(&results, format.name, "batch", best, frame_pixels * frames, input_bytes + output_bytes);
+			options.threads = set_thread_budget(threads, false);
+		}
+	}
+	catch (std::exception &e)
+	{
+		fprintf(stderr, "ctlbench: %s\n", e.what());
+		return 1;
+	}
+
+	FILE *json = json_file != NULL ? fopen(json_file, "w") : stdout;
+	if (json == NULL)
+	{
+		fprintf(stderr, "Unable to write %s (%s)\n", json_file, strerror(errno));
+		return 1;
+	}
+	fprintf(json, "{\n");
+	fprintf(json, "  \"width\": %u,\n  \"height\": %u,\n  \"channels\": %u,\n", width, height, depth);
+	fprintf(json, "  \"noalpha\": %s,\n", noalpha ? "true" : "false");
+	fprintf(json, "  \"frames\": %d,\n  \"repeat\": %d,\n", frames, repeat);
+	fprintf(json, "  \"threads\": %d,\n  \"inflight\": %d,\n  \"read_ahead\": %d,\n  \"strip_rows\": %d,\n  \"tile\": %d,\n", threads > 0 ? threads : hardware_threads(), frames_in_flight, read_ahead, options.strip_rows, options.tiling.width);
+	fprintf(json, "  \"chain\": %s,\n", json_string(chain_name).c_str());
+	fprintf(json, "  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const bench_result_t &result = results[i];
+		fprintf(json, "    { \"format\": %s, \"stage\": %s, \"seconds\": %.6f, \"mpix_per_s\": %.3f, \"mb_per_s\": %.3f }%s\n",
+		        json_string(result.format).c_str(), json_string(result.stage).c_str(), result.seconds,
+		        result.pixels / result.seconds / 1e6, result.bytes / result.seconds / 1e6,
+		        i + 1 < results.size() ? "," : "");
+	}
+	fprintf(json, "  ]\n}\n");
+	if (json != stdout)
+	{
+		fclose(json);
+	}
+
+	if (!keep)
+	{
+		for (size_t i = 0; i < written.size(); i++)
+		{
+			unlink(written[i].c_str());
+		}
+		rmdir(dir.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,443 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "dpx_convert.hh"
+#include "simd.hh"
+#include <string.h>
+
+static uint32_t swap32(uint32_t v)
+{
+	return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static uint16_t swap16(uint16_t v)
+{
+	return (v >> 8) | (v << 8);
+}
+
+// Scanlines may sit anywhere in a mapped file or a write buffer, so words
+// are copied in and out rather than assumed to be aligned.
+
+static void scalar_unpack10(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out)
+{
+	int shift = method_a ? 2 : 0;
+
+	for (size_t i = 0; i < count; i += 3, in += 4)
+	{
+		uint32_t word;
+		memcpy(&word, in, 4);
+		word = (swap ? swap32(word) : word) >> shift;
+		out[i] = ((word >> 20) & 0x3ff) * scale;
+		if (i + 1 < count)
+		{
+			out[i + 1] = ((word >> 10) & 0x3ff) * scale;
+		}
+		if (i + 2 < count)
+		{
+			out[i + 2] = (word & 0x3ff) * scale;
+		}
+	}
+}
+
+static void scalar_unpack12(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out)
+{
+	for (size_t i = 0; i < count; i++, in += 2)
+	{
+		uint16_t sample;
+		memcpy(&sample, in, 2);
+		sample = swap ? swap16(sample) : sample;
+		out[i] = (method_a ? sample >> 4 : sample & 0xfff) * scale;
+	}
+}
+
+static void scalar_pack10(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out)
+{
+	int shift = method_a ? 2 : 0;
+
+	for (size_t i = 0; i < count; i += 3, out += 4)
+	{
+		uint32_t word = quantize_sample<uint32_t>(in[i] * scale, 1023.0f) << 20;
+		if (i + 1 < count)
+		{
+			word |= quantize_sample<uint32_t>(in[i + 1] * scale, 1023.0f) << 10;
+		}
+		if (i + 2 < count)
+		{
+			word |= quantize_sample<uint32_t>(in[i + 2] * scale, 1023.0f);
+		}
+		word <<= shift;
+		word = swap ? swap32(word) : word;
+		memcpy(out, &word, 4);
+	}
+}
+
+static void scalar_pack12(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out)
+{
+	for (size_t i = 0; i < count; i++, out += 2)
+	{
+		uint16_t sample = quantize_sample<uint16_t>(in[i] * scale, 4095.0f) << (method_a ? 4 : 0);
+		sample = swap ? swap16(sample) : sample;
+		memcpy(out, &sample, 2);
+	}
+}
+
+static const dpx_kernels_t scalar_kernels =
+{
+	"scalar",
+	scalar_unpack10,
+	scalar_unpack12,
+	scalar_pack10,
+	scalar_pack12
+};
+
+#if defined(SIMD_X86)
+
+// Tails shorter than a vector go through the scalar loops.
+//
+// 10 bit unpacking takes 24 samples (eight words) at a time in three
+// overlapping 16 byte loads, each of which yields eight samples. A byte
+// shuffle puts the two bytes that hold each sample into its own 16 bit
+// lane, whichever the file's byte order, and a multiply then a shift by
+// 6 leave just the sample's ten bits. The shuffles and multipliers depend
+// on the byte order and the filling method, so they are worked out once
+// per scanline.
+
+struct dpx10_lanes_t
+{
+	__m128i shuffle[3];
+	__m128i multiplier[3];
+};
+
+static void dpx10_lanes(bool swap, bool method_a, dpx10_lanes_t &lanes)
+{
+	for (int load = 0; load < 3; load++)
+	{
+		uint8_t shuffle[16];
+		int16_t multiplier[8];
+
+		for (int l = 0; l < 8; l++)
+		{
+			int n = load * 8 + l;
+			int word = n / 3 * 4 - load * 8;
+			int c = n % 3;
+			// Sample c of a word lies within bits 8 * (2 - c) to 8 * (2 - c)
+			// + 15, starting at bit s of those sixteen.
+			int low = 2 - c;
+			int high = 3 - c;
+			int s = (method_a ? 6 : 4) - 2 * c;
+			shuffle[2 * l] = word + (swap ? 3 - low : low);
+			shuffle[2 * l + 1] = word + (swap ? 3 - high : high);
+			multiplier[l] = 1 << (6 - s);
+		}
+		memcpy(&lanes.shuffle[load], shuffle, 16);
+		memcpy(&lanes.multiplier[load], multiplier, 16);
+	}
+}
+
+static inline SIMD_TARGET("ssse3") __m128i ssse3_unpack10_lanes(const uint8_t *in, const dpx10_lanes_t &lanes, int load)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *) (in + load * 8));
+	v = _mm_mullo_epi16(_mm_shuffle_epi8(v, lanes.shuffle[load]), lanes.multiplier[load]);
+	return _mm_srli_epi16(v, 6);
+}
+
+// Byte shuffles that reverse each 16 or 32 bit word, or leave them be.
+static inline SIMD_TARGET("ssse3") __m128i ssse3_swap_mask(bool swap, int size)
+{
+	uint8_t mask[16];
+	for (int i = 0; i < 16; i++)
+	{
+		mask[i] = swap ? (i & ~(size - 1)) + size - 1 - (i & (size - 1)) : i;
+	}
+	__m128i v;
+	memcpy(&v, mask, 16);
+	return v;
+}
+
+static SIMD_TARGET("ssse3") void ssse3_unpack10(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out)
+{
+	dpx10_lanes_t lanes;
+	__m128 s = _mm_set1_ps(scale);
+	__m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	dpx10_lanes(swap, method_a, lanes);
+	for (; i + 24 <= count; i += 24, in += 32)
+	{
+		for (int load = 0; load < 3; load++)
+		{
+			__m128i v = ssse3_unpack10_lanes(in, lanes, load);
+			_mm_storeu_ps(out + i + load * 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), s));
+			_mm_storeu_ps(out + i + load * 8 + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), s));
+		}
+	}
+	scalar_unpack10(in, count - i, swap, method_a, scale, out + i);
+}
+
+static SIMD_TARGET("ssse3") void ssse3_unpack12(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out)
+{
+	__m128i order = ssse3_swap_mask(swap, 2);
+	__m128i keep = _mm_set1_epi16(method_a ? (short) 0xfff0 : 0x0fff);
+	__m128i shift = _mm_cvtsi32_si128(method_a ? 4 : 0);
+	__m128 s = _mm_set1_ps(scale);
+	__m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (in + 2 * i)), order);
+		v = _mm_srl_epi16(_mm_and_si128(v, keep), shift);
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), s));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), s));
+	}
+	scalar_unpack12(in + 2 * i, count - i, swap, method_a, scale, out + i);
+}
+
+// Twelve interleaved samples a, b, c in three vectors become the first,
+// second and third samples of four words.
+static inline SIMD_TARGET("ssse3") __m128i ssse3_pack10_words(__m128 a, __m128 b, __m128 c, __m128 scale, __m128 max,
+                                                             __m128i shift0, __m128i shift1, __m128i shift2)
+{
+	__m128 s0 = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 s1 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 s2 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	return _mm_or_si128(_mm_or_si128(_mm_sll_epi32(sse_quantize(s0, scale, max), shift0),
+	                                 _mm_sll_epi32(sse_quantize(s1, scale, max), shift1)),
+	                    _mm_sll_epi32(sse_quantize(s2, scale, max), shift2));
+}
+
+static SIMD_TARGET("ssse3") void ssse3_pack10(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out)
+{
+	int shift = method_a ? 2 : 0;
+	__m128i shift0 = _mm_cvtsi32_si128(20 + shift);
+	__m128i shift1 = _mm_cvtsi32_si128(10 + shift);
+	__m128i shift2 = _mm_cvtsi32_si128(shift);
+	__m128i order = ssse3_swap_mask(swap, 4);
+	__m128 s = _mm_set1_ps(scale);
+	__m128 max = _mm_set1_ps(1023.0f);
+	size_t i = 0;
+
+	for (; i + 12 <= count; i += 12, out += 16)
+	{
+		__m128i words = ssse3_pack10_words(_mm_loadu_ps(in + i), _mm_loadu_ps(in + i + 4), _mm_loadu_ps(in + i + 8),
+		                                   s, max, shift0, shift1, shift2);
+		_mm_storeu_si128((__m128i *) out, _mm_shuffle_epi8(words, order));
+	}
+	scalar_pack10(in + i, count - i, swap, method_a, scale, out);
+}
+
+static SIMD_TARGET("ssse3") void ssse3_pack12(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out)
+{
+	__m128i order = ssse3_swap_mask(swap, 2);
+	__m128i shift = _mm_cvtsi32_si128(method_a ? 4 : 0);
+	__m128 s = _mm_set1_ps(scale);
+	__m128 max = _mm_set1_ps(4095.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_packs_epi32(sse_quantize(_mm_loadu_ps(in + i), s, max), sse_quantize(_mm_loadu_ps(in + i + 4), s, max));
+		_mm_storeu_si128((__m128i *) (out + 2 * i), _mm_shuffle_epi8(_mm_sll_epi16(v, shift), order));
+	}
+	scalar_pack12(in + i, count - i, swap, method_a, scale, out + 2 * i);
+}
+
+static const dpx_kernels_t ssse3_kernels =
+{
+	"ssse3",
+	ssse3_unpack10,
+	ssse3_unpack12,
+	ssse3_pack10,
+	ssse3_pack12
+};
+
+// The same shuffles, with each 128 bit lane of a 256 bit vector holding
+// the words of a separate group.
+
+static SIMD_TARGET("avx2") void avx2_unpack10(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out)
+{
+	dpx10_lanes_t lanes;
+	__m256 s = _mm256_set1_ps(scale);
+	size_t i = 0;
+
+	dpx10_lanes(swap, method_a, lanes);
+	for (; i + 24 <= count; i += 24, in += 32)
+	{
+		for (int load = 0; load < 3; load++)
+		{
+			__m128i v = ssse3_unpack10_lanes(in, lanes, load);
+			_mm256_storeu_ps(out + i + load * 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v)), s));
+		}
+	}
+	scalar_unpack10(in, count - i, swap, method_a, scale, out + i);
+}
+
+static SIMD_TARGET("avx2") void avx2_unpack12(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out)
+{
+	__m128i order = ssse3_swap_mask(swap, 2);
+	__m256i order2 = _mm256_broadcastsi128_si256(order);
+	__m256i keep = _mm256_set1_epi16(method_a ? (short) 0xfff0 : 0x0fff);
+	__m128i shift = _mm_cvtsi32_si128(method_a ? 4 : 0);
+	__m256 s = _mm256_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (in + 2 * i)), order2);
+		v = _mm256_srl_epi16(_mm256_and_si256(v, keep), shift);
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v))), s));
+		_mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1))), s));
+	}
+	scalar_unpack12(in + 2 * i, count - i, swap, method_a, scale, out + i);
+}
+
+static inline SIMD_TARGET("avx2") __m256 avx2_load_groups(const float *in)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in)), _mm_loadu_ps(in + 12), 1);
+}
+
+static SIMD_TARGET("avx2") void avx2_pack10(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out)
+{
+	int shift = method_a ? 2 : 0;
+	__m128i shift0 = _mm_cvtsi32_si128(20 + shift);
+	__m128i shift1 = _mm_cvtsi32_si128(10 + shift);
+	__m128i shift2 = _mm_cvtsi32_si128(shift);
+	__m256i order = _mm256_broadcastsi128_si256(ssse3_swap_mask(swap, 4));
+	__m256 s = _mm256_set1_ps(scale);
+	__m256 max = _mm256_set1_ps(1023.0f);
+	size_t i = 0;
+
+	for (; i + 24 <= count; i += 24, out += 32)
+	{
+		__m256 a = avx2_load_groups(in + i);
+		__m256 b = avx2_load_groups(in + i + 4);
+		__m256 c = avx2_load_groups(in + i + 8);
+		__m256 s0 = _mm256_shuffle_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 s1 = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 s2 = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m256i words = _mm256_or_si256(_mm256_or_si256(_mm256_sll_epi32(avx2_quantize(s0, s, max), shift0),
+		                                                _mm256_sll_epi32(avx2_quantize(s1, s, max), shift1)),
+		                                _mm256_sll_epi32(avx2_quantize(s2, s, max), shift2));
+		_mm256_storeu_si256((__m256i *) out, _mm256_shuffle_epi8(words, order));
+	}
+	scalar_pack10(in + i, count - i, swap, method_a, scale, out);
+}
+
+static SIMD_TARGET("avx2") void avx2_pack12(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out)
+{
+	__m256i order = _mm256_broadcastsi128_si256(ssse3_swap_mask(swap, 2));
+	__m128i shift = _mm_cvtsi32_si128(method_a ? 4 : 0);
+	__m256 s = _mm256_set1_ps(scale);
+	__m256 max = _mm256_set1_ps(4095.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		// packs works within 128 bit lanes, the permute puts the samples
+		// back in order.
+		__m256i v = _mm256_packs_epi32(avx2_quantize(_mm256_loadu_ps(in + i), s, max), avx2_quantize(_mm256_loadu_ps(in + i + 8), s, max));
+		v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *) (out + 2 * i), _mm256_shuffle_epi8(_mm256_sll_epi16(v, shift), order));
+	}
+	scalar_pack12(in + i, count - i, swap, method_a, scale, out + 2 * i);
+}
+
+static const dpx_kernels_t avx2_kernels =
+{
+	"avx2",
+	avx2_unpack10,
+	avx2_unpack12,
+	avx2_pack10,
+	avx2_pack12
+};
+
+#endif
+
+const dpx_kernels_t *dpx_kernels_for(dpx_isa_t isa)
+{
+#if defined(SIMD_X86)
+	__builtin_cpu_init();
+	switch (isa)
+	{
+		case DPX_ISA_SSSE3:
+			return __builtin_cpu_supports("ssse3") ? &ssse3_kernels : NULL;
+		case DPX_ISA_AVX2:
+			return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+		default:
+			break;
+	}
+#endif
+	return isa == DPX_ISA_SCALAR ? &scalar_kernels : NULL;
+}
+
+static const dpx_kernels_t *best_dpx_kernels()
+{
+	const dpx_isa_t order[] = { DPX_ISA_AVX2, DPX_ISA_SSSE3 };
+
+	for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+	{
+		const dpx_kernels_t *kernels = dpx_kernels_for(order[i]);
+		if (kernels != NULL)
+		{
+			return kernels;
+		}
+	}
+	return &scalar_kernels;
+}
+
+const dpx_kernels_t &dpx_kernels()
+{
+	static const dpx_kernels_t *kernels = best_dpx_kernels();
+	return *kernels;
+}
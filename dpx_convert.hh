@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_DPX_CONVERT_INCLUDE)
+#define CTL_UTIL_CTLRENDER_DPX_CONVERT_INCLUDE
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample conversion between 10 and 12 bit dpx scanlines and interleaved
+// floats. swap is set when the file's byte order is not the host's, and
+// method_a when the samples are filled to the top of their 32 bit words
+// (10 bit) or 16 bit words (12 bit) rather than to the bottom. Reads
+// multiply each code value by scale; writes multiply by scale, clip to
+// the code range and round half up (NaN becomes 0). The last 32 bit word
+// of a 10 bit scanline is written whole, with unused samples zero. Every
+// variant gives bit for bit the results of the scalar one.
+
+enum dpx_isa_t
+{
+	DPX_ISA_SCALAR,
+	DPX_ISA_SSSE3,
+	DPX_ISA_AVX2
+};
+
+struct dpx_kernels_t
+{
+	const char *name;
+	void (*unpack10)(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out);
+	void (*unpack12)(const uint8_t *in, size_t count, bool swap, bool method_a, float scale, float *out);
+	void (*pack10)(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out);
+	void (*pack12)(const float *in, size_t count, bool swap, bool method_a, float scale, uint8_t *out);
+};
+
+// The fastest set this processor runs, chosen on first use.
+const dpx_kernels_t &dpx_kernels();
+
+// A particular set, or NULL when the build or the processor lacks it.
+const dpx_kernels_t *dpx_kernels_for(dpx_isa_t isa);
+
+#endif
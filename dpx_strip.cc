@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "strip.hh"
+#include "dpx_convert.hh"
+#include "simd.hh"
+#include <Iex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+// Just enough of SMPTE 268M to stream the first image element of the files
+// dpx_write produces, and of most others: 8 and 16 bit samples, and 10 and
+// 12 bit samples filled to 32 bit words (method A or B), uncompressed, RGB,
+// RGBA or luma. Anything else is left to dpx_read.
+
+static const uint32_t dpx_magic = 0x53445058; // "SDPX"
+static const uint32_t dpx_header_size = 2048;
+
+static bool host_is_big_endian()
+{
+	union
+	{
+		uint32_t word;
+		uint8_t bytes[4];
+	} probe;
+
+	probe.word = 1;
+	return probe.bytes[0] == 0;
+}
+
+static uint32_t swap32(uint32_t v)
+{
+	return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static uint16_t swap16(uint16_t v)
+{
+	return (v >> 8) | (v << 8);
+}
+
+static uint32_t header32(const uint8_t *header, size_t offset, bool swap)
+{
+	uint32_t v;
+	memcpy(&v, header + offset, 4);
+	return swap ? swap32(v) : v;
+}
+
+static uint16_t header16(const uint8_t *header, size_t offset, bool swap)
+{
+	uint16_t v;
+	memcpy(&v, header + offset, 2);
+	return swap ? swap16(v) : v;
+}
+
+static void set_header32(uint8_t *header, size_t offset, uint32_t v)
+{
+	if (!host_is_big_endian())
+	{
+		v = swap32(v);
+	}
+	memcpy(header + offset, &v, 4);
+}
+
+static void set_header16(uint8_t *header, size_t offset, uint16_t v)
+{
+	if (!host_is_big_endian())
+	{
+		v = swap16(v);
+	}
+	memcpy(header + offset, &v, 2);
+}
+
+// Bytes per scanline, rows start on 32 bit boundaries.
+static size_t dpx_row_bytes(uint32_t width, uint32_t channels, uint8_t bps)
+{
+	size_t samples = (size_t) width * channels;
+
+	if (bps == 10)
+	{
+		return (samples + 2) / 3 * 4;
+	}
+	return (samples * (bps == 8 ? 1 : 2) + 3) & ~(size_t) 3;
+}
+
+// Converts count samples of a scanline in file byte order to floats. The
+// scanline may sit anywhere in a mapped file, so it is read without any
+// alignment assumed.
+static void dpx_unpack_row(const dpx_kernels_t &kernels, const uint8_t *in, uint8_t bps, bool swap, bool method_a,
+                           size_t count, float scale, float *out)
+{
+	if (bps == 8)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = in[i] * scale;
+		}
+	}
+	else if (bps == 10)
+	{
+		kernels.unpack10(in, count, swap, method_a, scale, out);
+	}
+	else if (bps == 12)
+	{
+		kernels.unpack12(in, count, swap, method_a, scale, out);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++, in += 2)
+		{
+			uint16_t sample;
+			memcpy(&sample, in, 2);
+			out[i] = (swap ? swap16(sample) : sample) * scale;
+		}
+	}
+}
+
+// Converts count floats to a big endian scanline, 10 and 12 bit samples
+// filled by method A.
+static void dpx_pack_row(const dpx_kernels_t &kernels, const float *in, uint8_t bps, size_t count, float scale, uint8_t *out)
+{
+	bool swap = !host_is_big_endian();
+
+	if (bps == 8)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = quantize_sample<uint8_t>(in[i] * scale, 255.0f);
+		}
+	}
+	else if (bps == 10)
+	{
+		kernels.pack10(in, count, swap, true, scale, out);
+	}
+	else if (bps == 12)
+	{
+		kernels.pack12(in, count, swap, true, scale, out);
+	}
+	else
+	{
+		uint16_t *samples = (uint16_t *) out;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint16_t sample = quantize_sample<uint16_t>(in[i] * scale, 65535.0f);
+			samples[i] = swap ? swap16(sample) : sample;
+		}
+	}
+}
+
+// Decodes straight out of the mapped file, so there is no copy through a
+// read buffer and no system call per strip.
+class DpxStripReader: public StripReader
+{
+	public:
+		DpxStripReader(const uint8_t *map, size_t map_size, float input_scale, uint32_t width, uint32_t height,
+		               uint32_t channels, uint8_t bps, bool swap, bool method_a, uint32_t data_offset, size_t row_bytes)
+			: _map(map), _map_size(map_size), _kernels(dpx_kernels()), _bps(bps), _swap(swap), _method_a(method_a),
+			  _data_offset(data_offset), _row_bytes(row_bytes)
+		{
+			_width = width;
+			_height = height;
+			_channels = channels;
+			_format = format_t("dpx", bps);
+			_scale = 1.0 / (input_scale != 0.0 ? input_scale : (float) ((1 << bps) - 1));
+		}
+
+		virtual ~DpxStripReader()
+		{
+			munmap((void *) _map, _map_size);
+		}
+
+		virtual void read(uint32_t y, uint32_t rows, float *pixels)
+		{
+			size_t count = (size_t) _width * _channels;
+			const uint8_t *row = _map + _data_offset + (size_t) y * _row_bytes;
+
+			for (uint32_t r = 0; r < rows; r++, row += _row_bytes)
+			{
+				dpx_unpack_row(_kernels, row, _bps, _swap, _method_a, count, _scale, pixels + r * count);
+			}
+		}
+
+	private:
+		const uint8_t *_map;
+		size_t _map_size;
+		const dpx_kernels_t &_kernels;
+		uint8_t _bps;
+		bool _swap;
+		bool _method_a;
+		uint32_t _data_offset;
+		size_t _row_bytes;
+		float _scale;
+};
+
+// Packs scanlines into a large page aligned buffer that goes to the file
+// a few megabytes per write() rather than through stdio.
+class DpxStripWriter: public StripWriter
+{
+	public:
+		DpxStripWriter(int fd, float output_scale, uint32_t width, uint32_t height, uint32_t channels, uint8_t bps)
+			: _fd(fd), _kernels(dpx_kernels()), _width(width), _channels(channels), _bps(bps),
+			  _row_bytes(dpx_row_bytes(width, channels, bps)), _buffer(NULL), _used(0)
+		{
+			_capacity = std::max((size_t) dpx_buffer_size, dpx_header_size + _row_bytes);
+			if (posix_memalign(&_buffer, 4096, _capacity) != 0)
+			{
+				_buffer = NULL;
+				close(_fd);
+				THROW(Iex::BaseExc, "Unable to allocate the dpx write buffer");
+			}
+
+			uint8_t *header = (uint8_t *) _buffer;
+			uint8_t *element = header + 780;
+			uint32_t max = (1 << bps) - 1;
+
+			_scale = output_scale != 0.0 ? output_scale : (float) max;
+
+			memset(header, 0, dpx_header_size);
+			set_header32(header, 0, dpx_magic);
+			set_header32(header, 4, dpx_header_size);
+			strcpy((char *) header + 8, "V2.0");
+			set_header32(header, 16, dpx_header_size + height * _row_bytes);
+			set_header32(header, 20, 1);
+			set_header32(header, 24, 1664);
+			set_header32(header, 28, 384);
+			set_header32(header, 660, 0xffffffff);
+			strcpy((char *) header + 160, "ctlrender");
+
+			set_header16(header, 770, 1);
+			set_header32(header, 772, width);
+			set_header32(header, 776, height);
+			set_header32(element, 12, max);
+			element[20] = channels == 4 ? 51 : channels == 3 ? 50 : 6;
+			element[23] = bps;
+			set_header16(element, 24, bps == 10 || bps == 12 ? 1 : 0);
+			set_header32(element, 28, dpx_header_size);
+			_used = dpx_header_size;
+		}
+
+		virtual ~DpxStripWriter()
+		{
+			if (_fd >= 0)
+			{
+				close(_fd);
+			}
+			free(_buffer);
+		}
+
+		virtual void write(uint32_t rows, const float *pixels)
+		{
+			size_t count = (size_t) _width * _channels;
+
+			for (uint32_t r = 0; r < rows; r++)
+			{
+				if (_used + _row_bytes > _capacity)
+				{
+					flush();
+				}
+				uint8_t *row = (uint8_t *) _buffer + _used;
+				// Row padding stays zero.
+				memset(row + _row_bytes - 4, 0, 4);
+				dpx_pack_row(_kernels, pixels + r * count, _bps, count, _scale, row);
+				_used += _row_bytes;
+			}
+		}
+
+		virtual void finish()
+		{
+			flush();
+			int status = close(_fd);
+			_fd = -1;
+			if (status != 0)
+			{
+				THROW(Iex::IoExc, "Unable to close the dpx file");
+			}
+		}
+
+	private:
+		static const size_t dpx_buffer_size = 4 << 20;
+
+		void flush()
+		{
+			const uint8_t *data = (const uint8_t *) _buffer;
+
+			while (_used > 0)
+			{
+				ssize_t written = ::write(_fd, data, _used);
+				if (written < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (written <= 0)
+				{
+					THROW(Iex::IoExc, "Unable to write to the dpx file (" << strerror(errno) << ")");
+				}
+				data += written;
+				_used -= written;
+			}
+		}
+
+		int _fd;
+		const dpx_kernels_t &_kernels;
+		uint32_t _width;
+		uint32_t _channels;
+		uint8_t _bps;
+		size_t _row_bytes;
+		float _scale;
+		void *_buffer;
+		size_t _capacity;
+		size_t _used;
+};
+
+StripReader *dpx_strip_reader(const char *inputFile, float input_scale)
+{
+	struct stat file_status;
+	int fd = open(inputFile, O_RDONLY);
+
+	if (fd < 0)
+	{
+		return NULL;
+	}
+	if (fstat(fd, &file_status) < 0 || !S_ISREG(file_status.st_mode) || file_status.st_size < 1408)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	size_t map_size = file_status.st_size;
+	void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping holds its own reference to the file.
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	const uint8_t *header = (const uint8_t *) map;
+	uint32_t magic = header32(header, 0, false);
+	bool swap = magic != dpx_magic;
+	if (swap && magic != swap32(dpx_magic))
+	{
+		munmap(map, map_size);
+		return NULL;
+	}
+
+	const uint8_t *element = header + 780;
+	uint32_t width = header32(header, 772, swap);
+	uint32_t height = header32(header, 776, swap);
+	uint8_t descriptor = element[20];
+	uint8_t bps = element[23];
+	uint16_t packing = header16(element, 24, swap);
+	uint16_t encoding = header16(element, 26, swap);
+	uint32_t data_offset = header32(element, 28, swap);
+	uint32_t eol_padding = header32(element, 32, swap);
+	uint32_t channels = descriptor == 51 ? 4 : descriptor == 50 ? 3 : descriptor == 6 ? 1 : 0;
+
+	if (data_offset == 0xffffffff)
+	{
+		data_offset = header32(header, 4, swap);
+	}
+	if (eol_padding == 0xffffffff)
+	{
+		eol_padding = 0;
+	}
+
+	size_t row_bytes = dpx_row_bytes(width, channels, bps) + eol_padding;
+	// A truncated file is left to dpx_read, which reports it, rather than
+	// faulting on a page past the end of the mapping.
+	bool streamable = channels != 0 && encoding == 0 && width > 0 && height > 0 &&
+	                  (bps == 8 || bps == 16 || ((bps == 10 || bps == 12) && (packing == 1 || packing == 2))) &&
+	                  data_offset + (uint64_t) height * row_bytes <= map_size;
+	if (!streamable)
+	{
+		munmap(map, map_size);
+		return NULL;
+	}
+#if defined(MADV_SEQUENTIAL)
+	madvise(map, map_size, MADV_SEQUENTIAL);
+#endif
+	return new DpxStripReader(header, map_size, input_scale, width, height, channels, bps, swap, packing == 1, data_offset, row_bytes);
+}
+
+StripWriter *dpx_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                              uint32_t channels, const format_t &format)
+{
+	int fd = open(outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if (fd < 0)
+	{
+		THROW(Iex::IoExc, "Unable to open the dpx file " << outputFile << " for writing");
+	}
+	return new DpxStripWriter(fd, output_scale, width, height, channels, format.bps);
+}
@@ -0,0 +1,694 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "strip.hh"
+#include "half_convert.hh"
+#include <ImfInputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfTiledOutputFile.h>
+#include <ImfTileDescription.h>
+#include <ImfHeader.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfIntAttribute.h>
+#include <ImfStandardAttributes.h>
+#include <half.h>
+#include <Iex.h>
+#include <IlmThreadPool.h>
+#include <IlmThreadMutex.h>
+#include <IlmThreadSemaphore.h>
+#include <exception>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+static const char *exr_channel_names[] = { "R", "G", "B", "A" };
+
+// The ACES primaries and white point (SMPTE ST 2065-1).
+static const Imf::Chromaticities aces_chromaticities(Imath::V2f(0.7347, 0.2653), Imath::V2f(0.0, 1.0),
+                                                     Imath::V2f(0.0001, -0.0770), Imath::V2f(0.32168, 0.33767));
+
+static bool is_exr_file(const char *inputFile)
+{
+	unsigned char magic[4];
+	FILE *file = fopen(inputFile, "rb");
+	bool is_exr = false;
+
+	if (file != NULL)
+	{
+		is_exr = fread(magic, 1, 4, file) == 4 &&
+		         magic[0] == 0x76 && magic[1] == 0x2f && magic[2] == 0x31 && magic[3] == 0x01;
+		fclose(file);
+	}
+	return is_exr;
+}
+
+class ExrStripReader: public StripReader
+{
+	public:
+		ExrStripReader(const char *inputFile, float input_scale, bool alpha)
+			: _file(inputFile), _scale(input_scale != 0.0 ? input_scale : 1.0)
+		{
+			const Imf::Header &header = _file.header();
+			const Imath::Box2i &dw = header.dataWindow();
+			const Imf::Channel *r = header.channels().findChannel("R");
+
+			_x = dw.min.x;
+			_y = dw.min.y;
+			_width = dw.max.x - dw.min.x + 1;
+			_height = dw.max.y - dw.min.y + 1;
+			// Channels without a slice in the frame buffer are skipped by
+			// the decoder.
+			_channels = alpha && header.channels().findChannel("A") != NULL ? 4 : 3;
+			_format = format_t("exr", r != NULL && r->type == Imf::HALF ? 16 : 32);
+		}
+
+		// Luminance and luminance/chroma files have no R, G and B channels
+		// and need exr_read to be turned into RGB.
+		bool has_rgb() const
+		{
+			const Imf::ChannelList &channels = _file.header().channels();
+			return channels.findChannel("R") != NULL && channels.findChannel("G") != NULL &&
+			       channels.findChannel("B") != NULL;
+		}
+
+		virtual void read(uint32_t y, uint32_t rows, float *pixels)
+		{
+			Imf::FrameBuffer frame_buffer;
+			size_t xstride = _channels * sizeof(float);
+			size_t ystride = _width * xstride;
+			// Addressed by data window coordinates, so that row y lands at
+			// the start of pixels.
+			char *base = (char *) pixels - _x * xstride - (_y + (int) y) * ystride;
+
+			for (uint32_t c = 0; c < _channels; c++)
+			{
+				frame_buffer.insert(exr_channel_names[c],
+				                    Imf::Slice(Imf::FLOAT, base + c * sizeof(float), xstride, ystride, 1, 1, c == 3 ? 1.0 : 0.0));
+			}
+			_file.setFrameBuffer(frame_buffer);
+			_file.readPixels(_y + y, _y + y + rows - 1);
+
+			if (_scale != 1.0)
+			{
+				size_t count = (size_t) rows * _width * _channels;
+				for (size_t i = 0; i < count; i++)
+				{
+					pixels[i] *= _scale;
+				}
+			}
+		}
+
+	private:
+		Imf::InputFile _file;
+		float _scale;
+		int _x;
+		int _y;
+};
+
+class ExrStripWriter: public StripWriter
+{
+	public:
+		ExrStripWriter(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+		               uint32_t channels, const format_t &format, Compression *compression)
+			: _file(NULL), _scale(output_scale != 0.0 ? output_scale : 1.0), _width(width),
+			  _channels(channels), _format(format), _y(0)
+		{
+			Imf::Header header(width, height);
+			bool aces = !strcmp(format.ext, "aces");
+
+			_half = aces || format.bps == 16;
+			if (aces)
+			{
+				// An ACES container (SMPTE ST 2065-4) is an uncompressed,
+				// increasing y, half float exr with these attributes.
+				header.compression() = Imf::NO_COMPRESSION;
+				header.lineOrder() = Imf::INCREASING_Y;
+				Imf::addChromaticities(header, aces_chromaticities);
+				Imf::addAdoptedNeutral(header, aces_chromaticities.white);
+				header.insert("acesImageContainerFlag", Imf::IntAttribute(1));
+			}
+			else
+			{
+				header.compression() = (Imf::Compression) compression->exrCompressionScheme;
+			}
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				header.channels().insert(exr_channel_names[c], Imf::Channel(_half ? Imf::HALF : Imf::FLOAT));
+			}
+			_file = new Imf::OutputFile(outputFile, header);
+
+			// About a megabyte of converted samples, in whole multiples of
+			// 32 scanlines, the tallest block any of the compressors
+			// encodes, so that each window ends on a block boundary.
+			size_t row_bytes = (size_t) width * channels * (_half ? sizeof(half) : sizeof(float));
+			_window_rows = std::max((size_t) 1, (1 << 20) / std::max(row_bytes * 32, (size_t) 1)) * 32;
+		}
+
+		virtual ~ExrStripWriter()
+		{
+			delete _file;
+		}
+
+		virtual void write(uint32_t rows, const float *pixels)
+		{
+			size_t row_samples = (size_t) _width * _channels;
+
+			// Unscaled floats are handed to the encoder where they are.
+			if (!_half && _scale == 1.0)
+			{
+				write_rows(Imf::FLOAT, (const char *) pixels, sizeof(float), rows);
+				return;
+			}
+
+			// Anything else is converted a window of scanlines at a time,
+			// so the copy is never more than a window, not a whole frame.
+			for (uint32_t r = 0; r < rows; )
+			{
+				uint32_t n = std::min(_window_rows, rows - r);
+				const float *source = pixels + r * row_samples;
+				size_t count = n * row_samples;
+
+				if (_half)
+				{
+					_halfs.resize(std::max(_halfs.size(), count));
+					// Squished formats keep format_t's own per sample conversion.
+					if (_format.squish)
+					{
+						for (size_t i = 0; i < count; i++)
+						{
+							_halfs[i] = _format.float_to_half(source[i] / _scale);
+						}
+					}
+					else
+					{
+						float_to_half(source, count, _scale, &_halfs[0]);
+					}
+					write_rows(Imf::HALF, (const char *) &_halfs[0], sizeof(half), n);
+				}
+				else
+				{
+					_floats.resize(std::max(_floats.size(), count));
+					for (size_t i = 0; i < count; i++)
+					{
+						_floats[i] = source[i] / _scale;
+					}
+					write_rows(Imf::FLOAT, (const char *) &_floats[0], sizeof(float), n);
+				}
+				r += n;
+			}
+		}
+
+		virtual void finish()
+		{
+			// The line offset table is written when the file is closed.
+			delete _file;
+			_file = NULL;
+		}
+
+	private:
+		// Describes rows interleaved scanlines at data to the encoder as
+		// strided slices, one per channel, and writes them.
+		void write_rows(Imf::PixelType type, const char *data, size_t sample_size, uint32_t rows)
+		{
+			Imf::FrameBuffer frame_buffer;
+			size_t xstride = _channels * sample_size;
+			size_t ystride = _width * xstride;
+			char *base = (char *) data - _y * ystride;
+
+			for (uint32_t c = 0; c < _channels; c++)
+			{
+				frame_buffer.insert(exr_channel_names[c], Imf::Slice(type, base + c * sample_size, xstride, ystride));
+			}
+			_file->setFrameBuffer(frame_buffer);
+			_file->writePixels(rows);
+			_y += rows;
+		}
+
+		Imf::OutputFile *_file;
+		float _scale;
+		uint32_t _width;
+		uint32_t _channels;
+		format_t _format;
+		bool _half;
+		uint32_t _window_rows;
+		size_t _y;
+		std::vector<half> _halfs;
+		std::vector<float> _floats;
+};
+
+// Halves a row of interleaved samples in y, by averaging it with the row
+// below, and in x too when x is set. Sizes are rounded down, as those of
+// ROUND_DOWN levels are, but never below 1.
+static void halve_rows(const float *above, const float *below, uint32_t width, uint32_t channels, bool x, float *out)
+{
+	uint32_t w = x ? std::max(width / 2, (uint32_t) 1) : width;
+
+	for (uint32_t i = 0; i < w; i++)
+	{
+		uint32_t x0 = x ? 2 * i : i;
+		uint32_t x1 = x && 2 * i + 1 < width ? 2 * i + 1 : x0;
+		const float *p00 = above + (size_t) x0 * channels;
+		const float *p01 = above + (size_t) x1 * channels;
+		const float *p10 = below + (size_t) x0 * channels;
+		const float *p11 = below + (size_t) x1 * channels;
+
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			out[(size_t) i * channels + c] = 0.25f * (p00[c] + p01[c] + p10[c] + p11[c]);
+		}
+	}
+}
+
+// A row of tiles of level (lx, ly) converted for the encoder, starting at
+// scanline y of the level.
+struct exr_tile_row_t
+{
+	std::vector<char> data;
+	uint32_t y;
+	uint32_t rows;
+	uint32_t width;
+	int lx;
+	int ly;
+};
+
+// A level of a tiled file as its scanlines arrive. Each level is made from
+// one other: level 0 from the image, a mipmap level, and the first ripmap
+// level of a column, from the level above halved in y (and in x for
+// mipmaps), and the other ripmap levels from the level to their left
+// halved in x.
+struct exr_level_t
+{
+	uint32_t width;
+	uint32_t height;
+	int lx;
+	int ly;
+	// Scanlines received so far.
+	uint32_t y;
+	// The row of tiles being filled, and the scanlines in it.
+	exr_tile_row_t *next;
+	uint32_t filled;
+	// The levels made from this one, -1 for none, and whether the one
+	// halved in y is halved in x too.
+	int y_child;
+	int x_child;
+	bool y_halves_x;
+	// The even scanline waiting for the odd one below it, and a halved
+	// scanline on its way to a child.
+	std::vector<float> above;
+	std::vector<float> halved;
+};
+
+class ExrTiledWriter;
+
+class ExrTileTask: public IlmThread::Task
+{
+	public:
+		ExrTileTask(IlmThread::TaskGroup *group, ExrTiledWriter *writer, exr_tile_row_t *row)
+			: IlmThread::Task(group), _writer(writer), _row(row)
+		{
+		}
+
+		virtual void execute();
+
+	private:
+		ExrTiledWriter *_writer;
+		exr_tile_row_t *_row;
+};
+
+// Writes a tiled exr as the tiling asks. Scanlines are gathered into rows
+// of tiles, and each full row is handed to an encoder thread. It has the
+// OpenEXR threads compress the tiles of the row in parallel while the
+// caller goes on to the next strip, so that CTL evaluation and compression
+// overlap within a frame. Mipmap and ripmap levels are averaged down a
+// scanline at a time as the strips arrive, and their rows of tiles written
+// as they fill, in random y order, so no level is kept whole: besides two
+// rows of tiles waiting for the encoder, each level holds the row of tiles
+// it is filling and two scanlines.
+class ExrTiledWriter: public StripWriter
+{
+	public:
+		ExrTiledWriter(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+		               uint32_t channels, const format_t &format, Compression *compression, const exr_tiling_t &tiling)
+			: _file(NULL), _scale(output_scale != 0.0 ? output_scale : 1.0), _width(width), _height(height),
+			  _channels(channels), _format(format), _half(format.bps == 16),
+			  _tile_rows(tiling.height > 0 ? tiling.height : tiling.width),
+			  _encoder(1), _group(new IlmThread::TaskGroup()), _slots(2)
+		{
+			Imf::LevelMode levels = tiling.levels == 2 ? Imf::RIPMAP_LEVELS : tiling.levels == 1 ? Imf::MIPMAP_LEVELS : Imf::ONE_LEVEL;
+			Imf::Header header(width, height);
+
+			header.compression() = (Imf::Compression) compression->exrCompressionScheme;
+			header.setTileDescription(Imf::TileDescription(tiling.width, _tile_rows, levels, Imf::ROUND_DOWN));
+			if (levels != Imf::ONE_LEVEL)
+			{
+				// Lower levels fill as level 0 does, so their tiles arrive
+				// interleaved with it.
+				header.lineOrder() = Imf::RANDOM_Y;
+			}
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				header.channels().insert(exr_channel_names[c], Imf::Channel(_half ? Imf::HALF : Imf::FLOAT));
+			}
+			_file = new Imf::TiledOutputFile(outputFile, header);
+
+			if (levels == Imf::RIPMAP_LEVELS)
+			{
+				int nx = _file->numXLevels();
+				for (int ly = 0; ly < _file->numYLevels(); ly++)
+				{
+					for (int lx = 0; lx < nx; lx++)
+					{
+						if (lx > 0)
+						{
+							add_level(ly * nx + lx - 1, lx, ly, true, false);
+						}
+						else
+						{
+							add_level(ly > 0 ? (ly - 1) * nx : -1, lx, ly, false, true);
+						}
+					}
+				}
+			}
+			else
+			{
+				for (int l = 0; l < _file->numLevels(); l++)
+				{
+					add_level(l - 1, l, l, true, true);
+				}
+			}
+			// Every level may hold the row of tiles it is filling on top
+			// of the two waiting for the encoder.
+			for (size_t i = 1; i < _level.size(); i++)
+			{
+				_slots.post();
+			}
+		}
+
+		virtual ~ExrTiledWriter()
+		{
+			// Deleting the group waits for the encoder.
+			delete _group;
+			for (size_t i = 0; i < _level.size(); i++)
+			{
+				delete _level[i].next;
+			}
+			delete _file;
+		}
+
+		virtual void write(uint32_t rows, const float *pixels)
+		{
+			size_t row_samples = (size_t) _width * _channels;
+
+			for (uint32_t j = 0; j < rows; j++)
+			{
+				add_row(0, pixels + j * row_samples);
+			}
+		}
+
+		virtual void finish()
+		{
+			delete _group;
+			_group = NULL;
+			check_encoder();
+			// The tile offset table is written when the file is closed.
+			delete _file;
+			_file = NULL;
+		}
+
+		// Called on the encoder thread.
+		void encode(exr_tile_row_t *row)
+		{
+			try
+			{
+				int ty = row->y / _tile_rows;
+				write_tiles(&row->data[0], row->y, row->width, ty, row->lx, row->ly);
+			}
+			catch (std::exception &e)
+			{
+				IlmThread::Lock lock(_mutex);
+				if (_error.empty())
+				{
+					_error = e.what();
+				}
+			}
+			delete row;
+			_slots.post();
+		}
+
+	private:
+		size_t sample_size() const
+		{
+			return _half ? sizeof(half) : sizeof(float);
+		}
+
+		void check_encoder()
+		{
+			IlmThread::Lock lock(_mutex);
+			if (!_error.empty())
+			{
+				THROW(Iex::IoExc, _error);
+			}
+		}
+
+		// Adds level (lx, ly), made from level parent halved in x and y as
+		// asked. Level 0 has no parent and is the size of the image.
+		void add_level(int parent, int lx, int ly, bool x, bool y)
+		{
+			exr_level_t level;
+
+			level.width = _width;
+			level.height = _height;
+			level.lx = lx;
+			level.ly = ly;
+			level.y = 0;
+			level.next = NULL;
+			level.filled = 0;
+			level.y_child = -1;
+			level.x_child = -1;
+			level.y_halves_x = false;
+			if (parent >= 0)
+			{
+				exr_level_t &from = _level[parent];
+				level.width = x ? std::max(from.width / 2, (uint32_t) 1) : from.width;
+				level.height = y ? std::max(from.height / 2, (uint32_t) 1) : from.height;
+				if (y)
+				{
+					from.y_child = _level.size();
+					from.y_halves_x = x;
+					from.above.resize((size_t) from.width * _channels);
+				}
+				else
+				{
+					from.x_child = _level.size();
+				}
+				// Shared by both children, one at a time.
+				from.halved.resize(std::max(from.halved.size(), (size_t) level.width * _channels));
+			}
+			_level.push_back(level);
+		}
+
+		// Adds the next scanline of a level, and the scanlines it makes of
+		// the levels below it.
+		void add_row(int index, const float *row)
+		{
+			exr_level_t &level = _level[index];
+			size_t row_samples = (size_t) level.width * _channels;
+			size_t row_bytes = row_samples * sample_size();
+			uint32_t r = level.y++;
+
+			if (level.next == NULL)
+			{
+				_slots.wait();
+				check_encoder();
+				level.next = new exr_tile_row_t;
+				level.next->y = r;
+				level.next->width = level.width;
+				level.next->lx = level.lx;
+				level.next->ly = level.ly;
+				level.next->data.resize(_tile_rows * row_bytes);
+			}
+			convert(row, row_samples, &level.next->data[level.filled * row_bytes]);
+			level.filled++;
+			if (level.filled == _tile_rows || level.y == level.height)
+			{
+				level.next->rows = level.filled;
+				_encoder.addTask(new ExrTileTask(_group, this, level.next));
+				level.next = NULL;
+				level.filled = 0;
+			}
+
+			if (level.x_child >= 0)
+			{
+				halve_rows(row, row, level.width, _channels, true, &level.halved[0]);
+				add_row(level.x_child, &level.halved[0]);
+			}
+			if (level.y_child >= 0 && r / 2 < _level[level.y_child].height)
+			{
+				// A last even scanline without one below it is averaged
+				// with itself.
+				if (r % 2 == 0 && r + 1 < level.height)
+				{
+					std::copy(row, row + row_samples, level.above.begin());
+				}
+				else
+				{
+					halve_rows(r % 2 == 0 ? row : &level.above[0], row, level.width, _channels, level.y_halves_x,
+					           &level.halved[0]);
+					add_row(level.y_child, &level.halved[0]);
+				}
+			}
+		}
+
+		void convert(const float *source, size_t count, char *data)
+		{
+			if (_half)
+			{
+				half *halfs = (half *) data;
+				// Squished formats keep format_t's own per sample conversion.
+				if (_format.squish)
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						halfs[i] = _format.float_to_half(source[i] / _scale);
+					}
+				}
+				else
+				{
+					float_to_half(source, count, _scale, halfs);
+				}
+			}
+			else
+			{
+				float *floats = (float *) data;
+				for (size_t i = 0; i < count; i++)
+				{
+					floats[i] = source[i] / _scale;
+				}
+			}
+		}
+
+		// Writes the row of tiles ty of level (lx, ly) from converted
+		// samples of a width wide level, starting at scanline y.
+		void write_tiles(const char *data, uint32_t y, uint32_t width, int ty, int lx, int ly)
+		{
+			Imf::FrameBuffer frame_buffer;
+			size_t xstride = _channels * sample_size();
+			size_t ystride = width * xstride;
+			char *base = (char *) data - y * ystride;
+			Imf::PixelType type = _half ? Imf::HALF : Imf::FLOAT;
+
+			for (uint32_t c = 0; c < _channels; c++)
+			{
+				frame_buffer.insert(exr_channel_names[c], Imf::Slice(type, base + c * sample_size(), xstride, ystride));
+			}
+			_file->setFrameBuffer(frame_buffer);
+			_file->writeTiles(0, _file->numXTiles(lx) - 1, ty, ty, lx, ly);
+		}
+
+		Imf::TiledOutputFile *_file;
+		float _scale;
+		uint32_t _width;
+		uint32_t _height;
+		uint32_t _channels;
+		format_t _format;
+		bool _half;
+		uint32_t _tile_rows;
+		// In the order they are made, level 0 first.
+		std::vector<exr_level_t> _level;
+
+		IlmThread::ThreadPool _encoder;
+		IlmThread::TaskGroup *_group;
+		IlmThread::Semaphore _slots;
+		IlmThread::Mutex _mutex;
+		std::string _error;
+};
+
+void ExrTileTask::execute()
+{
+	_writer->encode(_row);
+}
+
+StripReader *exr_strip_reader(const char *inputFile, float input_scale, bool alpha)
+{
+	if (!is_exr_file(inputFile))
+	{
+		return NULL;
+	}
+	std::auto_ptr<ExrStripReader> reader(new ExrStripReader(inputFile, input_scale, alpha));
+	if (!reader->has_rgb())
+	{
+		return NULL;
+	}
+	return reader.release();
+}
+
+StripWriter *exr_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                              uint32_t channels, const format_t &format, Compression *compression,
+                              const exr_tiling_t &tiling)
+{
+	if (tiling.width > 0)
+	{
+		return new ExrTiledWriter(outputFile, output_scale, width, height, channels, format, compression, tiling);
+	}
+	return new ExrStripWriter(outputFile, output_scale, width, height, channels, format, compression);
+}
+
+StripWriter *aces_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                               uint32_t channels, const format_t &format)
+{
+	return new ExrStripWriter(outputFile, output_scale, width, height, channels, format, NULL);
+}
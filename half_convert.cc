@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "half_convert.hh"
+#include "simd.hh"
+
+static void table_float_to_half(const float *in, size_t count, float divisor, half *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = half(in[i] / divisor);
+	}
+}
+
+static const half_kernel_t table_kernel =
+{
+	"table",
+	table_float_to_half
+};
+
+#if defined(SIMD_X86)
+
+// vcvtps2ph rounds to nearest even, overflows to infinity and flushes
+// what is below the smallest half denormal to a signed zero, as half
+// does. The two would only part on signalling NaNs, where the instruction
+// sets the quiet bit and half does not, but the division has already
+// quieted those.
+static SIMD_TARGET("avx,f16c") void f16c_float_to_half(const float *in, size_t count, float divisor, half *out)
+{
+	__m256 d = _mm256_set1_ps(divisor);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 v = _mm256_div_ps(_mm256_loadu_ps(in + i), d);
+		_mm_storeu_si128((__m128i *) (out + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+	}
+	table_float_to_half(in + i, count - i, divisor, out + i);
+}
+
+static const half_kernel_t f16c_kernel =
+{
+	"f16c",
+	f16c_float_to_half
+};
+
+#endif
+
+const half_kernel_t *half_kernel_for(half_isa_t isa)
+{
+#if defined(SIMD_X86)
+	if (isa == HALF_ISA_F16C)
+	{
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c") ? &f16c_kernel : NULL;
+	}
+#endif
+	return isa == HALF_ISA_TABLE ? &table_kernel : NULL;
+}
+
+static const half_kernel_t *best_half_kernel()
+{
+	const half_kernel_t *kernel = half_kernel_for(HALF_ISA_F16C);
+	return kernel != NULL ? kernel : &table_kernel;
+}
+
+const half_kernel_t &half_kernel()
+{
+	static const half_kernel_t *kernel = best_half_kernel();
+	return *kernel;
+}
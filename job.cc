@@ -0,0 +1,712 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "job.hh"
+#include "batch.hh"
+#include <Iex.h>
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <sstream>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+class JobThread: public IlmThread::Thread
+{
+	public:
+		JobThread(Job *job) : _job(job)
+		{
+			start();
+		}
+
+		virtual void run()
+		{
+			_job->run();
+		}
+
+	private:
+		Job *_job;
+};
+
+Job::Job(float input_scale, float output_scale, const Compression &compression,
+         const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters,
+         int frames_in_flight, int read_ahead)
+	: _input_scale(input_scale), _output_scale(output_scale), _compression(compression),
+	  _frames_in_flight(frames_in_flight), _read_ahead(read_ahead), _lut_size(0), _lut_shaper(Lut3D::LINEAR),
+	  _baked_lut(NULL), _cache(NULL), _overwrite(false), _in_memory(false), _thread(NULL), _batch(NULL), _cancelled(false), _state(RUNNING),
+	  _frames_done(0), _start(0.0), _end(0.0)
+{
+	_lut_range[0] = 0.0;
+	_lut_range[1] = 1.0;
+
+	for (CTLOperations::const_iterator op = ctl_operations.begin(); op != ctl_operations.end(); op++)
+	{
+		ctl_operation_t ctl_operation;
+		ctl_operation.filename = keep(op->filename);
+		for (CTLParameters::const_iterator p = op->local.begin(); p != op->local.end(); p++)
+		{
+			ctl_operation.local.push_back(*p);
+			ctl_operation.local.back().name = keep(p->name);
+		}
+		_ctl_operations.push_back(ctl_operation);
+	}
+	for (CTLParameters::const_iterator p = global_ctl_parameters.begin(); p != global_ctl_parameters.end(); p++)
+	{
+		_global_ctl_parameters.push_back(*p);
+		_global_ctl_parameters.back().name = keep(p->name);
+	}
+}
+
+Job::~Job()
+{
+	cancel();
+	// Deleting the thread joins it.
+	delete _thread;
+	for (size_t i = 0; i < _sweep_images.size(); i++)
+	{
+		delete _sweep_images[i];
+	}
+}
+
+const char *Job::keep(const char *s)
+{
+	_strings.push_back(s);
+	return _strings.back().c_str();
+}
+
+void Job::set_lut(int size, Lut3D::shaper_t shaper, float lo, float hi, const Lut3D *baked)
+{
+	_baked_lut = baked;
+	_lut_size = size;
+	_lut_shaper = shaper;
+	_lut_range[0] = lo;
+	_lut_range[1] = hi;
+}
+
+void Job::set_cache(RenderCache *cache)
+{
+	_cache = cache;
+}
+
+void Job::set_options(const transform_options_t &options)
+{
+	_options = options;
+}
+
+const transform_options_t &Job::options() const
+{
+	return _options;
+}
+
+void Job::add_frame(const char *inputFile, const char *outputFile, const format_t &format)
+{
+	frame_source_t source;
+
+	source.frame.input = inputFile;
+	source.frame.output = outputFile;
+	source.frame.format = format;
+	source.is_sequence = false;
+	_sources.push_back(source);
+}
+
+void Job::add_frames(const char *inputFile, const sequence_t *sequence, const char *outputDirectory,
+                     const char *extension, const format_t &format)
+{
+	frame_source_t source;
+
+	source.frame.input = inputFile;
+	source.frame.format = format;
+	source.is_sequence = sequence != NULL;
+	if (sequence != NULL)
+	{
+		source.sequence = *sequence;
+	}
+	source.output_directory = outputDirectory;
+	source.extension = extension != NULL ? extension : "";
+	_sources.push_back(source);
+}
+
+void Job::set_overwrite(bool overwrite)
+{
+	_overwrite = overwrite;
+}
+
+static size_t source_length(const frame_source_t &source)
+{
+	return source.is_sequence ? sequence_length(source.sequence) : 1;
+}
+
+// Frame n of source, named as ctlrender names a source written to a
+// destination directory.
+static frame_t source_frame(const frame_source_t &source, size_t n)
+{
+	frame_t frame = source.frame;
+
+	if (source.is_sequence)
+	{
+		frame.input = sequence_file(source.sequence, n);
+	}
+	if (!source.output_directory.empty())
+	{
+		size_t slash = frame.input.rfind('/');
+		frame.output = source.output_directory + frame.input.substr(slash == std::string::npos ? 0 : slash + 1);
+
+		size_t dot = frame.output.rfind('.');
+		if (!source.extension.empty() && dot != std::string::npos && dot >= source.output_directory.size())
+		{
+			frame.output.replace(dot + 1, std::string::npos, source.extension);
+		}
+	}
+	return frame;
+}
+
+void Job::set_image(const char *inputFile, const format_t &format)
+{
+	_in_memory = true;
+	_image_file = inputFile != NULL ? inputFile : "";
+	_image_format = format;
+}
+
+ctl::dpx::fb<float> *Job::image()
+{
+	return &_image;
+}
+
+void Job::set_region(const region_t &region)
+{
+	_region = region;
+}
+
+void Job::set_sweep(const char *name, const std::vector<float> &values, const std::vector<std::string> &outputFiles, const format_t &format)
+{
+	_sweep_name = name;
+	_sweep_values = values;
+	_sweep_outputs = outputFiles;
+	_sweep_format = format;
+}
+
+bool Job::sweeping() const
+{
+	return !_sweep_values.empty();
+}
+
+const std::vector<ctl::dpx::fb<float> *> &Job::sweep_images() const
+{
+	return _sweep_images;
+}
+
+bool Job::in_memory() const
+{
+	return _in_memory && _sweep_outputs.empty();
+}
+
+float Job::output_scale() const
+{
+	return _output_scale;
+}
+
+void Job::run()
+{
+	{
+		IlmThread::Lock lock(_mutex);
+		_start = wall_clock();
+	}
+
+	try
+	{
+		if (_lut_size > 0 && _baked_lut == NULL)
+		{
+			_lut.reset(new Lut3D(_lut_size, _lut_shaper, _lut_range[0], _lut_range[1], _ctl_operations, _global_ctl_parameters, _options));
+		}
+
+		if (sweeping())
+		{
+			run_sweep();
+		}
+		else if (_in_memory)
+		{
+			transform_stats_t stats;
+			double start = wall_clock();
+
+			if (!_image_file.empty())
+			{
+				format_t image_format;
+				read_image_region(_image_file.c_str(), _input_scale, _region, &_image, &image_format,
+				                  source_alpha_used(_ctl_operations, _image_format, lut()));
+				stats.input = _image_file;
+				stats.read = wall_clock() - start;
+			}
+			transform_buffer(&_image, &_image_format, _ctl_operations, _global_ctl_parameters, _options, lut(), &stats);
+			stats.total = wall_clock() - start;
+
+			IlmThread::Lock lock(_mutex);
+			_frames_done = 1;
+			_stats.push_back(stats);
+		}
+		else
+		{
+			run_frames();
+		}
+
+		IlmThread::Lock lock(_mutex);
+		_state = _cancelled && _frames_done < frames_total() ? CANCELLED : DONE;
+	}
+	catch (std::exception &e)
+	{
+		IlmThread::Lock lock(_mutex);
+		_error = e.what();
+		_state = FAILED;
+	}
+
+	{
+		IlmThread::Lock lock(_mutex);
+		_end = wall_clock();
+	}
+	_finished.post();
+}
+
+// Everything but the source and output that decides what the job writes.
+// The scripts, and the modules they may import, are hashed by their text,
+// so an edit to any of them is a miss.
+RenderHash Job::chain_hash() const
+{
+	RenderHash hash;
+
+	for (CTLOperations::const_iterator op = _ctl_operations.begin(); op != _ctl_operations.end(); op++)
+	{
+		hash.add(std::string(op->filename));
+		hash.add_file_contents(op->filename);
+		std::vector<std::string> imports = ctl_module_imports(op->filename);
+		for (size_t i = 0; i < imports.size(); i++)
+		{
+			hash.add(imports[i]);
+			hash.add_file_contents(imports[i].c_str());
+		}
+		for (CTLParameters::const_iterator p = op->local.begin(); p != op->local.end(); p++)
+		{
+			hash.add(std::string(p->name));
+			hash.add(p->value, p->count * sizeof(float));
+		}
+	}
+	hash.add(std::string("global"));
+	for (CTLParameters::const_iterator p = _global_ctl_parameters.begin(); p != _global_ctl_parameters.end(); p++)
+	{
+		hash.add(std::string(p->name));
+		hash.add(p->value, p->count * sizeof(float));
+	}
+	hash.add((double) _input_scale);
+	hash.add((double) _output_scale);
+	hash.add(std::string(_compression.name != NULL ? _compression.name : ""));
+	hash.add((double) _lut_size);
+	if (_lut_size > 0)
+	{
+		hash.add((double) _lut_shaper);
+		hash.add((double) _lut_range[0]);
+		hash.add((double) _lut_range[1]);
+	}
+	// Only tiled files add to the key, so scanline keys stay as they were.
+	if (_options.tiling.width > 0)
+	{
+		hash.add(std::string("tiled"));
+		hash.add((double) _options.tiling.width);
+		hash.add((double) _options.tiling.height);
+		hash.add((double) _options.tiling.levels);
+	}
+	return hash;
+}
+
+std::string Job::cache_key(const RenderHash &chain, const frame_t &frame) const
+{
+	RenderHash hash = chain;
+
+	hash.add_file_identity(frame.input.c_str());
+	hash.add(std::string(frame.format.ext != NULL ? frame.format.ext : ""));
+	hash.add((double) frame.format.bps);
+	hash.add((double) frame.format.squish);
+	return hash.key();
+}
+
+// Puts the file the cache holds for frame in place. False when it holds
+// none.
+bool Job::fetch_cached(const std::string &key, const frame_t &frame)
+{
+	transform_stats_t stats;
+	double start = wall_clock();
+
+	if (!_cache->fetch(key, frame.output.c_str()))
+	{
+		return false;
+	}
+	stats.input = frame.input;
+	stats.output = frame.output;
+	stats.bytes_written = file_size(frame.output.c_str());
+	stats.cached = true;
+	stats.total = wall_clock() - start;
+	if (verbosity > 1)
+	{
+		fprintf(stderr, "  taken from cache: %s\n", frame.output.c_str());
+	}
+
+	IlmThread::Lock lock(_mutex);
+	_frames_done++;
+	_outputs.push_back(frame.output);
+	_stats.push_back(stats);
+	return true;
+}
+
+// Checks the destination of the next frame as it would be checked were
+// the frames written one at a time: a file already there, or written by
+// an earlier frame, is refused, or with _overwrite replaced. An earlier
+// frame of the same name is finished first, pending frames included, so
+// that the later one is what is left. False, with refusal set, when the
+// job should stop here.
+bool Job::claim_output(const std::string &output, Batch *batch, Frames *pending, std::set<std::string> *claimed, std::string *refusal)
+{
+	std::ostringstream message;
+
+	if (!claimed->insert(output).second)
+	{
+		if (!_overwrite)
+		{
+			message << "Cravenly refusing to overwrite the file '" << output << "'.";
+			*refusal = message.str();
+			return false;
+		}
+		for (; !pending->empty(); pending->pop_front())
+		{
+			batch->add(pending->front().input.c_str(), pending->front().output.c_str(), pending->front().format);
+		}
+		batch->wait();
+	}
+	if (_overwrite && unlink(output.c_str()) < 0 && errno != ENOENT)
+	{
+		message << "Unable to remove existing file named '" << output << "' (" << strerror(errno) << ").";
+		*refusal = message.str();
+		return false;
+	}
+	if (access(output.c_str(), F_OK) >= 0)
+	{
+		message << "Cravenly refusing to overwrite the file '" << output << "'.";
+		*refusal = message.str();
+		return false;
+	}
+	return true;
+}
+
+// Frames are named, checked and looked up in the cache only as the batch
+// gets to them, so a long sequence costs no more up front than its
+// pattern. Those left to transform wait in pending, the next one to add
+// included, and at most _read_ahead of them are read ahead, so the batch
+// never holds more than the frame buffers it states.
+void Job::run_frames()
+{
+	RenderHash chain;
+	std::map<std::string, std::string> keys;
+	std::set<std::string> claimed;
+	std::string refusal;
+	Frames pending;
+	FrameSources::const_iterator source = _sources.begin();
+	size_t n = 0;
+
+	if (_cache != NULL)
+	{
+		chain = chain_hash();
+	}
+
+	Batch batch(_input_scale, _output_scale, &_compression, _ctl_operations, _global_ctl_parameters, _options, _frames_in_flight, lut(), _read_ahead);
+	{
+		IlmThread::Lock lock(_mutex);
+		_batch = &batch;
+	}
+
+	while (!batch.failed())
+	{
+		{
+			IlmThread::Lock lock(_mutex);
+			if (_cancelled)
+			{
+				break;
+			}
+		}
+		while (pending.size() < (size_t) std::max(_read_ahead, 1) && source != _sources.end() && refusal.empty())
+		{
+			frame_t frame = source_frame(*source, n);
+			if (++n == source_length(*source))
+			{
+				source++;
+				n = 0;
+			}
+			if (!claim_output(frame.output, &batch, &pending, &claimed, &refusal))
+			{
+				break;
+			}
+			if (_cache != NULL)
+			{
+				std::string key = cache_key(chain, frame);
+				if (fetch_cached(key, frame))
+				{
+					continue;
+				}
+				keys[frame.output] = key;
+			}
+			batch.read_ahead(frame.input.c_str(), frame.format);
+			pending.push_back(frame);
+		}
+		if (pending.empty())
+		{
+			break;
+		}
+		batch.add(pending.front().input.c_str(), pending.front().output.c_str(), pending.front().format);
+		pending.pop_front();
+	}
+	batch.wait();
+
+	std::vector<std::string> outputs = batch.outputs();
+	std::vector<transform_stats_t> stats = batch.stats();
+	if (_cache != NULL)
+	{
+		// Every file that was written is whole, even when others failed.
+		for (size_t i = 0; i < outputs.size(); i++)
+		{
+			std::map<std::string, std::string>::const_iterator key = keys.find(outputs[i]);
+			if (key != keys.end())
+			{
+				_cache->store(key->second, outputs[i].c_str());
+			}
+		}
+	}
+
+	IlmThread::Lock lock(_mutex);
+	_batch = NULL;
+	// Cached frames were counted as they were reached.
+	_frames_done += batch.frames_done();
+	_outputs.insert(_outputs.end(), outputs.begin(), outputs.end());
+	_stats.insert(_stats.end(), stats.begin(), stats.end());
+	if (batch.failed())
+	{
+		THROW(Iex::BaseExc, batch.error());
+	}
+	if (!refusal.empty())
+	{
+		THROW(Iex::ArgExc, refusal);
+	}
+}
+
+// The source is decoded once and its CTL inputs made once, only the swept
+// parameter changes from one result to the next.
+void Job::run_sweep()
+{
+	format_t image_format;
+	double start = wall_clock();
+
+	if (!_image_file.empty())
+	{
+		read_image_region(_image_file.c_str(), _input_scale, _region, &_image, &image_format,
+		                  source_alpha_used(_ctl_operations, _sweep_format));
+	}
+	double read = wall_clock() - start;
+
+	transform_sweep(_image, image_format, _sweep_format, _ctl_operations, _global_ctl_parameters, _options,
+	                _sweep_name.c_str(), _sweep_values, this);
+
+	IlmThread::Lock lock(_mutex);
+	if (!_stats.empty())
+	{
+		// The read is charged to the first result.
+		_stats[0].input = _image_file;
+		_stats[0].read = read;
+		_stats[0].bytes_read = _image_file.empty() ? 0.0 : file_size(_image_file.c_str());
+		_stats[0].total += read;
+	}
+}
+
+// Called by transform_sweep with the result for _sweep_values[i].
+bool Job::add(size_t i, ctl::dpx::fb<float> *image_buffer, format_t *format, transform_stats_t *stats)
+{
+	double start = wall_clock();
+
+	if (_sweep_outputs.empty())
+	{
+		ctl::dpx::fb<float> *image = new ctl::dpx::fb<float>();
+		image->init(image_buffer->width(), image_buffer->height(), image_buffer->depth());
+		memcpy(image->ptr(), image_buffer->ptr(), image_buffer->pixels() * image_buffer->depth() * sizeof(float));
+		_sweep_images.push_back(image);
+	}
+	else
+	{
+		write_image(_sweep_outputs[i].c_str(), _output_scale, *image_buffer, format, &_compression, _options.tiling);
+		stats->output = _sweep_outputs[i];
+		stats->write = wall_clock() - start;
+		stats->bytes_written = file_size(_sweep_outputs[i].c_str());
+	}
+	stats->total = stats->mkresult + stats->mkimage + wall_clock() - start;
+	for (size_t k = 0; k < stats->operations.size(); k++)
+	{
+		stats->total += stats->operations[k];
+	}
+
+	IlmThread::Lock lock(_mutex);
+	_frames_done++;
+	if (!_sweep_outputs.empty())
+	{
+		_outputs.push_back(_sweep_outputs[i]);
+	}
+	_stats.push_back(*stats);
+	return !_cancelled;
+}
+
+void Job::start()
+{
+	_thread = new JobThread(this);
+}
+
+void Job::wait()
+{
+	// Leave the semaphore posted for whoever waits next.
+	_finished.wait();
+	_finished.post();
+}
+
+void Job::cancel()
+{
+	IlmThread::Lock lock(_mutex);
+
+	_cancelled = true;
+	if (_batch != NULL)
+	{
+		_batch->cancel();
+	}
+}
+
+Job::state_t Job::state()
+{
+	IlmThread::Lock lock(_mutex);
+	return _state;
+}
+
+size_t Job::frames_done()
+{
+	IlmThread::Lock lock(_mutex);
+	// Cached frames are done before the batch starts.
+	return _frames_done + (_batch != NULL ? _batch->frames_done() : 0);
+}
+
+size_t Job::frames_total()
+{
+	if (sweeping())
+	{
+		return _sweep_values.size();
+	}
+	if (_in_memory)
+	{
+		return 1;
+	}
+
+	size_t total = 0;
+	for (FrameSources::const_iterator source = _sources.begin(); source != _sources.end(); source++)
+	{
+		total += source_length(*source);
+	}
+	return total;
+}
+
+double Job::elapsed()
+{
+	IlmThread::Lock lock(_mutex);
+
+	if (_start == 0.0)
+	{
+		return 0.0;
+	}
+	return (_state == RUNNING ? wall_clock() : _end) - _start;
+}
+
+std::vector<std::string> Job::outputs()
+{
+	IlmThread::Lock lock(_mutex);
+	std::vector<std::string> outputs = _outputs;
+
+	if (_batch != NULL)
+	{
+		std::vector<std::string> written = _batch->outputs();
+		outputs.insert(outputs.end(), written.begin(), written.end());
+	}
+	return outputs;
+}
+
+std::string Job::error()
+{
+	IlmThread::Lock lock(_mutex);
+	return _error;
+}
+
+const Lut3D *Job::lut() const
+{
+	return _baked_lut != NULL ? _baked_lut : _lut.get();
+}
+
+std::vector<transform_stats_t> Job::stats()
+{
+	IlmThread::Lock lock(_mutex);
+	std::vector<transform_stats_t> stats = _stats;
+
+	if (_batch != NULL)
+	{
+		std::vector<transform_stats_t> written = _batch->stats();
+		stats.insert(stats.end(), written.begin(), written.end());
+	}
+	return stats;
+}
@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_JOB_INCLUDE)
+#define CTL_UTIL_CTLRENDER_JOB_INCLUDE
+
+#include "transform.hh"
+#include "lut.hh"
+#include "region.hh"
+#include "render_cache.hh"
+#include "sequence.hh"
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <IlmThread.h>
+#include <IlmThreadMutex.h>
+#include <IlmThreadSemaphore.h>
+
+class Batch;
+class JobThread;
+
+struct frame_t
+{
+	std::string input;
+	std::string output;
+	format_t format;
+};
+typedef std::list<frame_t> Frames;
+
+// What a job is given to transform: one file, or every frame of a
+// sequence. With an output directory each frame is written to a file of
+// its own name there, taking extension in place of its own when that is
+// set. The frames of a sequence are only named, and their destinations
+// only checked, once the job reaches them.
+struct frame_source_t
+{
+	frame_t frame;
+	bool is_sequence;
+	sequence_t sequence;
+	std::string output_directory;
+	std::string extension;
+};
+typedef std::list<frame_source_t> FrameSources;
+
+// Everything one ctl call asks for: the operations and parameters, and
+// either a list of files to transform or a single image whose result is
+// kept in memory. A Job holds copies of all its strings so that it can
+// outlive the arguments of the call that made it, and it can be run in
+// the calling thread or on a thread of its own.
+class Job: private SweepResults
+{
+	public:
+		enum state_t
+		{
+			RUNNING,
+			DONE,
+			FAILED,
+			CANCELLED
+		};
+
+		Job(float input_scale, float output_scale, const Compression &compression,
+		    const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters,
+		    int frames_in_flight, int read_ahead = 0);
+		~Job();
+
+		// Bakes the operations into a lut when the job runs. With baked the
+		// lut was made beforehand with the same settings, and is kept by
+		// the caller until the job is gone.
+		void set_lut(int size, Lut3D::shaper_t shaper, float lo, float hi, const Lut3D *baked = NULL);
+
+		// Takes the files this job would write from cache when an earlier
+		// job made them from the same source, scripts and settings, and
+		// keeps the ones it writes there. Not used in memory.
+		void set_cache(RenderCache *cache);
+
+		// Settings every frame of the job is transformed with, taken when
+		// the job is made so later calls cannot change them.
+		void set_options(const transform_options_t &options);
+		const transform_options_t &options() const;
+
+		void add_frame(const char *inputFile, const char *outputFile, const format_t &format);
+
+		// Queues inputFile, or with a sequence every frame of it, to be
+		// written in outputDirectory as frame_source_t describes.
+		void add_frames(const char *inputFile, const sequence_t *sequence, const char *outputDirectory,
+		                const char *extension, const format_t &format);
+
+		// Destinations are checked as ctlrender checks them, when each
+		// frame is reached: a file that is already there, or that an
+		// earlier frame of the job wrote, is refused, or with overwrite
+		// replaced.
+		void set_overwrite(bool overwrite);
+
+		// Makes this an in memory job on image(), which is either filled by
+		// the caller (inputFile NULL) or read from inputFile when the job
+		// runs.
+		void set_image(const char *inputFile, const format_t &format);
+		ctl::dpx::fb<float> *image();
+
+		// Limits an image read from a file by set_image, for an in memory
+		// job or a sweep, to region. An image filled by the caller is
+		// expected to be cut to it already.
+		void set_region(const region_t &region);
+
+		// Makes this a sweep of the parameter name over values, run on the
+		// source given to set_image. The result for values[i] is written to
+		// outputFiles[i] in format, or without outputFiles kept in
+		// sweep_images().
+		void set_sweep(const char *name, const std::vector<float> &values, const std::vector<std::string> &outputFiles, const format_t &format);
+		bool sweeping() const;
+		const std::vector<ctl::dpx::fb<float> *> &sweep_images() const;
+
+		// True when the result stays in memory rather than going to files.
+		bool in_memory() const;
+		float output_scale() const;
+
+		void run();
+		void start();
+		void wait();
+		void cancel();
+
+		state_t state();
+		size_t frames_done();
+		size_t frames_total();
+		double elapsed();
+		std::vector<std::string> outputs();
+		std::string error();
+		const Lut3D *lut() const;
+		std::vector<transform_stats_t> stats();
+
+	private:
+		const char *keep(const char *s);
+		void run_sweep();
+		std::string cache_key(const RenderHash &chain, const frame_t &frame) const;
+		RenderHash chain_hash() const;
+		bool fetch_cached(const std::string &key, const frame_t &frame);
+		void run_frames();
+		bool claim_output(const std::string &output, Batch *batch, Frames *pending, std::set<std::string> *claimed, std::string *refusal);
+		virtual bool add(size_t i, ctl::dpx::fb<float> *image_buffer, format_t *format, transform_stats_t *stats);
+
+		float _input_scale;
+		float _output_scale;
+		Compression _compression;
+		CTLOperations _ctl_operations;
+		CTLParameters _global_ctl_parameters;
+		int _frames_in_flight;
+		int _read_ahead;
+		transform_options_t _options;
+		std::list<std::string> _strings;
+
+		int _lut_size;
+		Lut3D::shaper_t _lut_shaper;
+		float _lut_range[2];
+		std::auto_ptr<Lut3D> _lut;
+		const Lut3D *_baked_lut;
+		RenderCache *_cache;
+
+		FrameSources _sources;
+		bool _overwrite;
+		bool _in_memory;
+		std::string _image_file;
+		region_t _region;
+		format_t _image_format;
+		ctl::dpx::fb<float> _image;
+		std::string _sweep_name;
+		std::vector<float> _sweep_values;
+		std::vector<std::string> _sweep_outputs;
+		format_t _sweep_format;
+		std::vector<ctl::dpx::fb<float> *> _sweep_images;
+
+		JobThread *_thread;
+		IlmThread::Semaphore _finished;
+		IlmThread::Mutex _mutex;
+		Batch *_batch;
+		bool _cancelled;
+		state_t _state;
+		size_t _frames_done;
+		std::vector<std::string> _outputs;
+		std::vector<transform_stats_t> _stats;
+		std::string _error;
+		double _start;
+		double _end;
+};
+
+#endif
@@ -0,0 +1,311 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "lut.hh"
+#include <Iex.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Number of pixels of the first frame evaluated exactly to estimate the
+// interpolation error.
+static const size_t lut_check_samples = 4096;
+
+Lut3D::Lut3D(int size, shaper_t shaper, float lo, float hi,
+             const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters,
+             const transform_options_t &options)
+	: _size(size), _shaper(shaper), _lo(lo), _hi(hi),
+	  _ctl_operations(ctl_operations), _global_ctl_parameters(global_ctl_parameters), _options(options),
+	  _checked(false), _max_error(0.0), _error_samples(0)
+{
+	ctl::dpx::fb<float> lattice;
+	format_t lattice_format;
+	float *p;
+
+	if (size < 2)
+	{
+		THROW(Iex::ArgExc, "a 3D LUT needs at least 2 points per axis.");
+	}
+	if (!(hi > lo))
+	{
+		THROW(Iex::ArgExc, "the 3D LUT range must have its upper end above its lower end.");
+	}
+
+	// Red varies fastest, then green, then blue.
+	lattice.init(size, size * size, 3);
+	p = lattice.ptr();
+	for (int b = 0; b < size; b++)
+	{
+		for (int g = 0; g < size; g++)
+		{
+			for (int r = 0; r < size; r++)
+			{
+				*(p++) = shaper_to_linear(lo + (hi - lo) * r / (size - 1));
+				*(p++) = shaper_to_linear(lo + (hi - lo) * g / (size - 1));
+				*(p++) = shaper_to_linear(lo + (hi - lo) * b / (size - 1));
+			}
+		}
+	}
+
+	lattice_format.squish = true;
+	transform_buffer(&lattice, &lattice_format, ctl_operations, global_ctl_parameters, options);
+
+	// Entries are padded to four floats so a lattice point is one vector.
+	_table.resize((size_t) size * size * size * 4);
+	p = lattice.ptr();
+	for (size_t i = 0; i < _table.size(); i += 4)
+	{
+		_table[i + 0] = *(p++);
+		_table[i + 1] = *(p++);
+		_table[i + 2] = *(p++);
+		_table[i + 3] = 0.0;
+	}
+}
+
+float Lut3D::shaper_to_linear(float x) const
+{
+	return _shaper == LOG2 ? powf(2.0f, x) : x;
+}
+
+void Lut3D::lookup(const float *in, size_t count, size_t in_stride, float *out, size_t out_stride) const
+{
+	const float scale = (_size - 1) / (_hi - _lo);
+	const float top = (float) (_size - 1);
+	const size_t dr = 4;
+	const size_t dg = 4 * _size;
+	const size_t db = 4 * _size * _size;
+	const float *table = &_table[0];
+
+	for (size_t n = 0; n < count; n++, in += in_stride, out += out_stride)
+	{
+		float x[3];
+		size_t base[3];
+		float f[3];
+
+		for (int c = 0; c < 3; c++)
+		{
+			float v = in[c];
+			if (_shaper == LOG2)
+			{
+				v = v > 0.0f ? log2f(v) : _lo;
+			}
+			v = (v - _lo) * scale;
+			// Written so that NaN ends up at the bottom of the range.
+			x[c] = v > 0.0f ? (v < top ? v : top) : 0.0f;
+			base[c] = std::min((size_t) x[c], (size_t) (_size - 2));
+			f[c] = x[c] - base[c];
+		}
+
+		const float *c000 = table + base[0] * dr + base[1] * dg + base[2] * db;
+		const float *v1;
+		const float *v2;
+		float w0, w1, w2, w3;
+
+		// Pick the tetrahedron containing the point from the order of the
+		// fractions, each one shares the c000 to c111 diagonal.
+		if (f[0] > f[1])
+		{
+			if (f[1] > f[2])
+			{
+				v1 = c000 + dr; v2 = c000 + dr + dg;
+				w0 = 1 - f[0]; w1 = f[0] - f[1]; w2 = f[1] - f[2]; w3 = f[2];
+			}
+			else if (f[0] > f[2])
+			{
+				v1 = c000 + dr; v2 = c000 + dr + db;
+				w0 = 1 - f[0]; w1 = f[0] - f[2]; w2 = f[2] - f[1]; w3 = f[1];
+			}
+			else
+			{
+				v1 = c000 + db; v2 = c000 + dr + db;
+				w0 = 1 - f[2]; w1 = f[2] - f[0]; w2 = f[0] - f[1]; w3 = f[1];
+			}
+		}
+		else
+		{
+			if (f[2] > f[1])
+			{
+				v1 = c000 + db; v2 = c000 + dg + db;
+				w0 = 1 - f[2]; w1 = f[2] - f[1]; w2 = f[1] - f[0]; w3 = f[0];
+			}
+			else if (f[2] > f[0])
+			{
+				v1 = c000 + dg; v2 = c000 + dg + db;
+				w0 = 1 - f[1]; w1 = f[1] - f[2]; w2 = f[2] - f[0]; w3 = f[0];
+			}
+			else
+			{
+				v1 = c000 + dg; v2 = c000 + dr + dg;
+				w0 = 1 - f[1]; w1 = f[1] - f[0]; w2 = f[0] - f[2]; w3 = f[2];
+			}
+		}
+		const float *c111 = c000 + dr + dg + db;
+
+#if defined(__SSE2__)
+		__m128 sum = _mm_mul_ps(_mm_set1_ps(w0), _mm_loadu_ps(c000));
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w1), _mm_loadu_ps(v1)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w2), _mm_loadu_ps(v2)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w3), _mm_loadu_ps(c111)));
+
+		float result[4];
+		_mm_storeu_ps(result, sum);
+		out[0] = result[0];
+		out[1] = result[1];
+		out[2] = result[2];
+#else
+		for (int c = 0; c < 3; c++)
+		{
+			out[c] = w0 * c000[c] + w1 * v1[c] + w2 * v2[c] + w3 * c111[c];
+		}
+#endif
+	}
+}
+
+void Lut3D::check(const ctl::dpx::fb<float> &image_buffer) const
+{
+	ctl::dpx::fb<float> exact;
+	format_t exact_format;
+	std::vector<float> interpolated;
+	size_t pixels = image_buffer.pixels();
+	size_t samples = std::min(pixels, lut_check_samples);
+	uint32_t depth = image_buffer.depth();
+	float error = 0.0;
+
+	if (samples == 0 || depth < 3)
+	{
+		return;
+	}
+
+	exact.init(samples, 1, 3);
+	for (size_t i = 0; i < samples; i++)
+	{
+		const float *in = image_buffer.ptr() + (i * pixels / samples) * depth;
+		memcpy(exact.ptr() + i * 3, in, 3 * sizeof(float));
+	}
+
+	interpolated.resize(samples * 3);
+	lookup(exact.ptr(), samples, 3, &interpolated[0], 3);
+
+	exact_format.squish = true;
+	transform_buffer(&exact, &exact_format, _ctl_operations, _global_ctl_parameters, _options);
+
+	for (size_t i = 0; i < samples * 3; i++)
+	{
+		float e = fabsf(interpolated[i] - exact.ptr()[i]);
+		if (e > error || e != e)
+		{
+			error = e;
+		}
+	}
+
+	_max_error = error;
+	_error_samples = samples;
+}
+
+void Lut3D::apply(ctl::dpx::fb<float> *image_buffer, format_t *format) const
+{
+	uint32_t depth = image_buffer->depth();
+	size_t pixels = image_buffer->pixels();
+
+	{
+		IlmThread::Lock lock(_mutex);
+		if (!_checked)
+		{
+			_checked = true;
+			check(*image_buffer);
+		}
+	}
+
+	if (depth < 3)
+	{
+		// Single channel source, 'G' drives all three inputs just as it
+		// does for the CTL scripts.
+		std::vector<float> grey(image_buffer->ptr(), image_buffer->ptr() + pixels * depth);
+		image_buffer->init(image_buffer->width(), image_buffer->height(), 3);
+		float *p = image_buffer->ptr();
+		for (size_t i = 0; i < pixels; i++)
+		{
+			p[i * 3] = p[i * 3 + 1] = p[i * 3 + 2] = grey[i * depth];
+		}
+		depth = 3;
+	}
+
+	lookup(image_buffer->ptr(), pixels, depth, image_buffer->ptr(), depth);
+
+	if (depth == 4 && format->squish)
+	{
+		std::vector<float> rgba(image_buffer->ptr(), image_buffer->ptr() + pixels * 4);
+		image_buffer->init(image_buffer->width(), image_buffer->height(), 3);
+		float *p = image_buffer->ptr();
+		for (size_t i = 0; i < pixels; i++)
+		{
+			memcpy(p + i * 3, &rgba[i * 4], 3 * sizeof(float));
+		}
+	}
+}
+
+float Lut3D::max_error() const
+{
+	IlmThread::Lock lock(_mutex);
+	return _max_error;
+}
+
+size_t Lut3D::error_samples() const
+{
+	IlmThread::Lock lock(_mutex);
+	return _error_samples;
+}
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_LUT_INCLUDE)
+#define CTL_UTIL_CTLRENDER_LUT_INCLUDE
+
+#include "transform.hh"
+#include <vector>
+#include <IlmThreadMutex.h>
+
+// A CTL chain (with fixed parameters) baked into a size^3 lattice and
+// applied with tetrahedral interpolation. The lattice is laid out in a
+// shaper space over [lo, hi], which is either the linear value or its
+// log2. Only R, G and B go through the table, alpha is passed on.
+//
+// The first frame the table is applied to is also evaluated exactly on a
+// sample of its pixels, giving max_error() as a measure of whether the
+// table is accurate enough for the chain.
+class Lut3D
+{
+	public:
+		enum shaper_t
+		{
+			LINEAR,
+			LOG2
+		};
+
+		Lut3D(int size, shaper_t shaper, float lo, float hi,
+		      const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters,
+		      const transform_options_t &options);
+
+		void apply(ctl::dpx::fb<float> *image_buffer, format_t *format) const;
+
+		float max_error() const;
+		size_t error_samples() const;
+
+	private:
+		void lookup(const float *in, size_t count, size_t in_stride, float *out, size_t out_stride) const;
+		void check(const ctl::dpx::fb<float> &image_buffer) const;
+		float shaper_to_linear(float x) const;
+
+		int _size;
+		shaper_t _shaper;
+		float _lo;
+		float _hi;
+		std::vector<float> _table;
+
+		const CTLOperations &_ctl_operations;
+		const CTLParameters &_global_ctl_parameters;
+		transform_options_t _options;
+
+		mutable IlmThread::Mutex _mutex;
+		mutable bool _checked;
+		mutable float _max_error;
+		mutable size_t _error_samples;
+};
+
+#endif
@@ -62,6 +62,19 @@
 
 extern int verbosity;
 
+// How exr output is tiled.
+struct exr_tiling_t
+{
+	exr_tiling_t() : width(0), height(0), levels(0) {}
+
+	// Tile size, width 0 for scanline files and height 0 for square tiles.
+	int width;
+	int height;
+
+	// 0 for one level, 1 for mipmap and 2 for ripmap levels.
+	int levels;
+};
+
 // Defined in usage.cc
 void usage(const char *section=NULL);
 
@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "region.hh"
+#include "strip.hh"
+#include "transform.hh"
+#include <Iex.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <string.h>
+
+region_t::region_t() : x(0), y(0), width(0), height(0), step(1)
+{
+}
+
+bool region_t::whole() const
+{
+	return x == 0 && y == 0 && width == 0 && height == 0 && step <= 1;
+}
+
+region_t clip_region(const region_t &region, uint32_t width, uint32_t height)
+{
+	region_t clipped = region;
+
+	if (region.x >= width || region.y >= height)
+	{
+		THROW(Iex::ArgExc, "the region starting at " << region.x << ", " << region.y << " is outside the "
+		      << width << " x " << height << " image.");
+	}
+	clipped.width = region.width == 0 ? width - region.x : std::min(region.width, width - region.x);
+	clipped.height = region.height == 0 ? height - region.y : std::min(region.height, height - region.y);
+	clipped.step = std::max(region.step, (uint32_t) 1);
+	return clipped;
+}
+
+uint32_t region_columns(const region_t &clipped)
+{
+	return (clipped.width + clipped.step - 1) / clipped.step;
+}
+
+uint32_t region_rows(const region_t &clipped)
+{
+	return (clipped.height + clipped.step - 1) / clipped.step;
+}
+
+// Keeps the region's columns of a row of width pixels.
+static void copy_region_row(const float *row, const region_t &clipped, uint32_t channels, float *out)
+{
+	const float *in = row + (size_t) clipped.x * channels;
+	uint32_t columns = region_columns(clipped);
+
+	if (clipped.step == 1)
+	{
+		memcpy(out, in, (size_t) columns * channels * sizeof(float));
+		return;
+	}
+	for (uint32_t i = 0; i < columns; i++, in += (size_t) clipped.step * channels, out += channels)
+	{
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			out[c] = in[c];
+		}
+	}
+}
+
+void crop_image(const ctl::dpx::fb<float> &image_buffer, const region_t &region, ctl::dpx::fb<float> *cropped)
+{
+	region_t clipped = clip_region(region, image_buffer.width(), image_buffer.height());
+	uint32_t channels = image_buffer.depth();
+	size_t row_floats = (size_t) image_buffer.width() * channels;
+
+	cropped->init(region_columns(clipped), region_rows(clipped), channels);
+	for (uint32_t j = 0; j < cropped->height(); j++)
+	{
+		const float *row = image_buffer.ptr() + (clipped.y + (size_t) j * clipped.step) * row_floats;
+		copy_region_row(row, clipped, channels, cropped->ptr() + (size_t) j * cropped->width() * channels);
+	}
+}
+
+void read_image_region(const char *inputFile, float input_scale, const region_t &region, ctl::dpx::fb<float> *image_buffer,
+                       format_t *image_format, bool alpha)
+{
+	if (region.whole())
+	{
+		read_image(inputFile, input_scale, image_buffer, image_format, alpha);
+		return;
+	}
+
+	std::auto_ptr<StripReader> reader(open_strip_reader(inputFile, input_scale, alpha));
+	if (reader.get() == NULL)
+	{
+		ctl::dpx::fb<float> whole;
+		read_image(inputFile, input_scale, &whole, image_format, alpha);
+		crop_image(whole, region, image_buffer);
+		return;
+	}
+
+	region_t clipped = clip_region(region, reader->width(), reader->height());
+	uint32_t channels = reader->channels();
+	size_t row_floats = (size_t) reader->width() * channels;
+	// Without decimation the rows are read a band at a time, otherwise one
+	// at a time so the rows skipped are never converted.
+	uint32_t band = clipped.step == 1 ? 64 : 1;
+	std::vector<float> rows(band * row_floats);
+	uint32_t out_rows = region_rows(clipped);
+	float *out;
+
+	image_buffer->init(region_columns(clipped), out_rows, channels);
+	out = image_buffer->ptr();
+	for (uint32_t j = 0; j < out_rows; j += band)
+	{
+		uint32_t n = std::min(band, out_rows - j);
+
+		reader->read(clipped.y + j * clipped.step, n, &rows[0]);
+		for (uint32_t k = 0; k < n; k++, out += (size_t) image_buffer->width() * channels)
+		{
+			copy_region_row(&rows[k * row_floats], clipped, channels, out);
+		}
+	}
+	*image_format = reader->format();
+}
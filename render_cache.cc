@@ -0,0 +1,384 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "render_cache.hh"
+#include <Iex.h>
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static const uint64_t fnv_prime = 1099511628211ULL;
+
+RenderHash::RenderHash()
+{
+	_h[0] = 14695981039346656037ULL;
+	_h[1] = 0x9e3779b97f4a7c15ULL;
+}
+
+void RenderHash::add(const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *) data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		_h[0] = (_h[0] ^ p[i]) * fnv_prime;
+		_h[1] = (_h[1] ^ p[i]) * fnv_prime;
+	}
+	// Keeps "ab" + "c" apart from "a" + "bc".
+	uint64_t length = size;
+	for (int i = 0; i < 8; i++)
+	{
+		_h[1] = (_h[1] ^ ((length >> (8 * i)) & 0xff)) * fnv_prime;
+	}
+}
+
+void RenderHash::add(const std::string &s)
+{
+	add(s.data(), s.size());
+}
+
+void RenderHash::add(double value)
+{
+	add(&value, sizeof(value));
+}
+
+void RenderHash::add_file_identity(const char *filename)
+{
+	struct stat file_status;
+
+	if (stat(filename, &file_status) < 0)
+	{
+		add(std::string(filename));
+		return;
+	}
+	add((double) file_status.st_dev);
+	add((double) file_status.st_ino);
+	add((double) file_status.st_size);
+	add((double) file_status.st_mtime);
+#if defined(__APPLE__)
+	add((double) file_status.st_mtimespec.tv_nsec);
+#else
+	add((double) file_status.st_mtim.tv_nsec);
+#endif
+}
+
+void RenderHash::add_file_contents(const char *filename)
+{
+	FILE *file = fopen(filename, "rb");
+	char buffer[65536];
+	size_t n;
+
+	if (file == NULL)
+	{
+		add(std::string(filename));
+		return;
+	}
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		add(buffer, n);
+	}
+	fclose(file);
+}
+
+std::string RenderHash::key() const
+{
+	char hex[33];
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 16; j++)
+		{
+			hex[i * 16 + j] = "0123456789abcdef"[(_h[i] >> (60 - 4 * j)) & 0xf];
+		}
+	}
+	hex[32] = 0;
+	return hex;
+}
+
+static bool copy_file(const char *from, const char *to)
+{
+	FILE *in = fopen(from, "rb");
+	FILE *out;
+	char buffer[65536];
+	size_t n;
+	bool ok = true;
+
+	if (in == NULL)
+	{
+		return false;
+	}
+	out = fopen(to, "wb");
+	if (out == NULL)
+	{
+		fclose(in);
+		return false;
+	}
+	while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+	{
+		ok = fwrite(buffer, 1, n, out) == n;
+	}
+	ok = ok && !ferror(in);
+	fclose(in);
+	if (fclose(out) != 0 || !ok)
+	{
+		unlink(to);
+		return false;
+	}
+	return true;
+}
+
+// A hard link where the file system allows one, a copy otherwise.
+static bool place_file(const char *from, const char *to)
+{
+	return link(from, to) >= 0 || copy_file(from, to);
+}
+
+RenderCache::RenderCache(const std::string &directory, double max_bytes)
+	: _directory(directory), _max_bytes(max_bytes), _hits(0), _misses(0), _stores(0), _evictions(0),
+	  _entries(0), _bytes(0.0)
+{
+	while (_directory.size() > 1 && _directory[_directory.size() - 1] == '/')
+	{
+		_directory.erase(_directory.size() - 1);
+	}
+	if (mkdir(_directory.c_str(), 0777) < 0 && errno != EEXIST)
+	{
+		THROW(Iex::IoExc, "unable to create the cache directory " << _directory << " (" << strerror(errno) << ").");
+	}
+	scan(true);
+}
+
+const std::string &RenderCache::directory() const
+{
+	return _directory;
+}
+
+void RenderCache::set_max_bytes(double max_bytes)
+{
+	IlmThread::Lock lock(_mutex);
+
+	_max_bytes = max_bytes;
+	if (_bytes > _max_bytes)
+	{
+		scan(true);
+	}
+}
+
+// Entries keep the extension of the output, so that they are readable
+// files of their own.
+std::string RenderCache::entry(const std::string &key, const char *outputFile) const
+{
+	const char *slash = strrchr(outputFile, '/');
+	const char *dot = strrchr(slash != NULL ? slash : outputFile, '.');
+
+	return _directory + "/" + key + (dot != NULL ? dot : "");
+}
+
+bool RenderCache::fetch(const std::string &key, const char *outputFile)
+{
+	IlmThread::Lock lock(_mutex);
+	std::string path = entry(key, outputFile);
+
+	if (access(path.c_str(), R_OK) < 0 || !place_file(path.c_str(), outputFile))
+	{
+		_misses++;
+		return false;
+	}
+	// Now the most recently used.
+	utime(path.c_str(), NULL);
+	_hits++;
+	return true;
+}
+
+void RenderCache::store(const std::string &key, const char *outputFile)
+{
+	IlmThread::Lock lock(_mutex);
+	std::string path = entry(key, outputFile);
+	std::string part = path + ".part";
+	struct stat file_status;
+
+	// Moved into place whole, so a fetch never finds half an entry.
+	unlink(part.c_str());
+	if (!place_file(outputFile, part.c_str()) || stat(part.c_str(), &file_status) < 0 ||
+	    rename(part.c_str(), path.c_str()) < 0)
+	{
+		unlink(part.c_str());
+		return;
+	}
+	_stores++;
+	_entries++;
+	_bytes += file_status.st_size;
+	if (_bytes > _max_bytes)
+	{
+		scan(true);
+	}
+}
+
+struct cache_entry_t
+{
+	double used;
+	double bytes;
+	std::string path;
+
+	bool operator<(const cache_entry_t &other) const
+	{
+		return used < other.used;
+	}
+};
+
+// Counts the entries on disk, which other sessions may have changed, and
+// when evicting removes the least recently used until they fit.
+void RenderCache::scan(bool evict)
+{
+	std::vector<cache_entry_t> found;
+	DIR *dir = opendir(_directory.c_str());
+	struct dirent *d;
+
+	_entries = 0;
+	_bytes = 0.0;
+	if (dir == NULL)
+	{
+		return;
+	}
+	while ((d = readdir(dir)) != NULL)
+	{
+		std::string name = d->d_name;
+		struct stat file_status;
+		cache_entry_t e;
+
+		if (name.size() < 32 || name.find_first_not_of("0123456789abcdef") < 32 ||
+		    (name.size() > 5 && name.compare(name.size() - 5, 5, ".part") == 0))
+		{
+			continue;
+		}
+		e.path = _directory + "/" + name;
+		if (stat(e.path.c_str(), &file_status) < 0 || !S_ISREG(file_status.st_mode))
+		{
+			continue;
+		}
+#if defined(__APPLE__)
+		e.used = file_status.st_mtime + file_status.st_mtimespec.tv_nsec * 1e-9;
+#else
+		e.used = file_status.st_mtime + file_status.st_mtim.tv_nsec * 1e-9;
+#endif
+		e.bytes = file_status.st_size;
+		found.push_back(e);
+		_bytes += e.bytes;
+	}
+	closedir(dir);
+	_entries = found.size();
+
+	if (evict && _bytes > _max_bytes)
+	{
+		std::sort(found.begin(), found.end());
+		for (size_t i = 0; i < found.size() && _bytes > _max_bytes; i++)
+		{
+			if (unlink(found[i].path.c_str()) >= 0)
+			{
+				_bytes -= found[i].bytes;
+				_entries--;
+				_evictions++;
+			}
+		}
+	}
+}
+
+size_t RenderCache::hits()
+{
+	IlmThread::Lock lock(_mutex);
+	return _hits;
+}
+
+size_t RenderCache::misses()
+{
+	IlmThread::Lock lock(_mutex);
+	return _misses;
+}
+
+size_t RenderCache::stores()
+{
+	IlmThread::Lock lock(_mutex);
+	return _stores;
+}
+
+size_t RenderCache::evictions()
+{
+	IlmThread::Lock lock(_mutex);
+	return _evictions;
+}
+
+size_t RenderCache::entries()
+{
+	IlmThread::Lock lock(_mutex);
+	return _entries;
+}
+
+double RenderCache::bytes()
+{
+	IlmThread::Lock lock(_mutex);
+	return _bytes;
+}
+
+double RenderCache::max_bytes()
+{
+	IlmThread::Lock lock(_mutex);
+	return _max_bytes;
+}
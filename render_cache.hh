@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_RENDER_CACHE_INCLUDE)
+#define CTL_UTIL_CTLRENDER_RENDER_CACHE_INCLUDE
+
+#include <stdint.h>
+#include <string>
+#include <IlmThreadMutex.h>
+
+// Builds the key of a cache entry from everything that decides the output
+// file. Two 64 bit FNV-1a hashes with different offsets make up the 128
+// bits of the key.
+class RenderHash
+{
+	public:
+		RenderHash();
+
+		void add(const void *data, size_t size);
+		void add(const std::string &s);
+		void add(double value);
+
+		// The file by identity: device, inode, size and modification
+		// and change times. A file that cannot be found adds its name.
+		void add_file_identity(const char *filename);
+
+		// The file by contents, for sources such as CTL scripts that are
+		// small and edited in place.
+		void add_file_contents(const char *filename);
+
+		// 32 hex digits.
+		std::string key() const;
+
+	private:
+		uint64_t _h[2];
+};
+
+// A directory of finished output files named by the key of what made
+// them. A hit puts the entry in place of the output with a hard link, or a
+// copy across file systems. Entries are evicted least recently used first
+// (by modification time, which a hit refreshes) once they take more than
+// max_bytes. Safe to use from several threads.
+class RenderCache
+{
+	public:
+		// Creates directory when it does not exist.
+		RenderCache(const std::string &directory, double max_bytes);
+
+		const std::string &directory() const;
+		void set_max_bytes(double max_bytes);
+
+		// Makes outputFile from the entry for key. False, counting a miss,
+		// when there is no such entry.
+		bool fetch(const std::string &key, const char *outputFile);
+
+		// Keeps outputFile, which has just been written, as the entry for
+		// key.
+		void store(const std::string &key, const char *outputFile);
+
+		// Since the cache was opened.
+		size_t hits();
+		size_t misses();
+		size_t stores();
+		size_t evictions();
+
+		// Of the directory as last scanned and stored to.
+		size_t entries();
+		double bytes();
+		double max_bytes();
+
+	private:
+		std::string entry(const std::string &key, const char *outputFile) const;
+		void scan(bool evict);
+
+		std::string _directory;
+		double _max_bytes;
+		IlmThread::Mutex _mutex;
+		size_t _hits;
+		size_t _misses;
+		size_t _stores;
+		size_t _evictions;
+		size_t _entries;
+		double _bytes;
+};
+
+#endif
@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "sequence.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool parse_sequence_pattern(const char *pattern, sequence_t *sequence)
+{
+	const char *hash = strchr(pattern, '#');
+	const char *percent = strchr(pattern, '%');
+	const char *end = NULL;
+	int padding = 0;
+
+	if (hash != NULL && (percent == NULL || hash < percent))
+	{
+		for (end = hash; *end == '#'; end++)
+		{
+			padding++;
+		}
+		percent = hash;
+	}
+	else
+	{
+		for (; percent != NULL; percent = strchr(percent + 1, '%'))
+		{
+			end = percent + 1;
+			if (*end == '0')
+			{
+				char *digits_end = NULL;
+				padding = strtol(end, &digits_end, 10);
+				end = digits_end;
+			}
+			if (*end == 'd')
+			{
+				end++;
+				break;
+			}
+			padding = 0;
+		}
+		if (percent == NULL)
+		{
+			return false;
+		}
+	}
+
+	if (padding > SEQUENCE_MAX_PADDING)
+	{
+		return false;
+	}
+
+	sequence->prefix.assign(pattern, percent - pattern);
+	sequence->suffix = end;
+	sequence->padding = padding;
+	return true;
+}
+
+bool parse_frame_ranges(const char *ranges, sequence_t *sequence)
+{
+	std::vector<frame_range_t> parsed;
+	const char *s = ranges;
+
+	while (true)
+	{
+		frame_range_t range;
+		char *end = NULL;
+
+		if (*s < '0' || *s > '9')
+		{
+			return false;
+		}
+		range.first = strtol(s, &end, 10);
+		range.last = range.first;
+		range.step = 1;
+		if (*end == '-')
+		{
+			s = end + 1;
+			if (*s < '0' || *s > '9')
+			{
+				return false;
+			}
+			range.last = strtol(s, &end, 10);
+			if (*end == 'x')
+			{
+				s = end + 1;
+				if (*s < '0' || *s > '9')
+				{
+					return false;
+				}
+				range.step = strtol(s, &end, 10);
+			}
+		}
+		if (range.last < range.first || range.step < 1)
+		{
+			return false;
+		}
+		parsed.push_back(range);
+
+		if (*end == 0)
+		{
+			break;
+		}
+		if (*end != ',')
+		{
+			return false;
+		}
+		s = end + 1;
+	}
+
+	sequence->ranges.insert(sequence->ranges.end(), parsed.begin(), parsed.end());
+	return true;
+}
+
+static size_t range_length(const frame_range_t &range)
+{
+	return (range.last - range.first) / range.step + 1;
+}
+
+size_t sequence_length(const sequence_t &sequence)
+{
+	size_t length = 0;
+
+	for (size_t i = 0; i < sequence.ranges.size(); i++)
+	{
+		length += range_length(sequence.ranges[i]);
+	}
+	return length;
+}
+
+std::string sequence_file(const sequence_t &sequence, size_t n)
+{
+	char number[SEQUENCE_MAX_PADDING + 2];
+	long frame = 0;
+
+	for (size_t i = 0; i < sequence.ranges.size(); i++)
+	{
+		size_t length = range_length(sequence.ranges[i]);
+		if (n < length)
+		{
+			frame = sequence.ranges[i].first + (long) n * sequence.ranges[i].step;
+			break;
+		}
+		n -= length;
+	}
+	snprintf(number, sizeof(number), "%0*ld", sequence.padding, frame);
+	return sequence.prefix + number + sequence.suffix;
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_SEQUENCE_INCLUDE)
+#define CTL_UTIL_CTLRENDER_SEQUENCE_INCLUDE
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// A numbered image sequence, given as a file name pattern and the frames
+// it covers rather than as one name per frame. The frame number takes the
+// place of a printf style %d or %0<n>d, or of a run of '#', one digit per
+// '#' (plate.%06d.dpx and plate.######.dpx are the same). Ranges are a
+// comma separated list of <first>, <first>-<last> or <first>-<last>x<step>,
+// such as 1001-6000 or 1-99x2,100.
+
+struct frame_range_t
+{
+	long first;
+	long last;
+	long step;
+};
+
+struct sequence_t
+{
+	std::string prefix;
+	std::string suffix;
+	int padding;
+	std::vector<frame_range_t> ranges;
+};
+
+// Frame numbers are padded to at most this many digits, which is more than
+// a long has.
+#define SEQUENCE_MAX_PADDING 20
+
+// Fills in the name part of sequence. Returns false when pattern holds no
+// frame number, or pads it to more than SEQUENCE_MAX_PADDING digits.
+bool parse_sequence_pattern(const char *pattern, sequence_t *sequence);
+
+// Appends the ranges given in ranges to sequence. Returns false, leaving
+// sequence as it was, when they do not parse.
+bool parse_frame_ranges(const char *ranges, sequence_t *sequence);
+
+// Number of frames in sequence.
+size_t sequence_length(const sequence_t &sequence);
+
+// The file name of frame n (counting from 0) of sequence. Names are made as
+// they are needed, so a long sequence costs no more than its pattern.
+std::string sequence_file(const sequence_t &sequence, size_t n);
+
+#endif
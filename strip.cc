@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "strip.hh"
+#include <string.h>
+
+StripReader::StripReader() : _width(0), _height(0), _channels(0)
+{
+}
+
+StripReader::~StripReader()
+{
+}
+
+uint32_t StripReader::width() const
+{
+	return _width;
+}
+
+uint32_t StripReader::height() const
+{
+	return _height;
+}
+
+uint32_t StripReader::channels() const
+{
+	return _channels;
+}
+
+const format_t &StripReader::format() const
+{
+	return _format;
+}
+
+StripWriter::~StripWriter()
+{
+}
+
+StripReader *open_strip_reader(const char *inputFile, float input_scale, bool alpha)
+{
+	StripReader *reader;
+
+	// Same order as read_image. Interleaved dpx and tiff samples are
+	// unpacked whole, alpha included.
+	reader = exr_strip_reader(inputFile, input_scale, alpha);
+	if (reader == NULL)
+	{
+		reader = dpx_strip_reader(inputFile, input_scale);
+	}
+	if (reader == NULL)
+	{
+		reader = tiff_strip_reader(inputFile, input_scale);
+	}
+	return reader;
+}
+
+bool can_write_strips(const format_t &format)
+{
+	if (format.ext == NULL)
+	{
+		return false;
+	}
+	if (!strcmp(format.ext, "exr"))
+	{
+		return format.bps == 16 || format.bps == 32;
+	}
+	if (!strcmp(format.ext, "tif") || !strcmp(format.ext, "tiff"))
+	{
+		return format.bps == 8 || format.bps == 16 || format.bps == 32;
+	}
+	if (!strcmp(format.ext, "dpx"))
+	{
+		return format.bps == 8 || format.bps == 10 || format.bps == 12 || format.bps == 16;
+	}
+	return !strcmp(format.ext, "aces");
+}
+
+StripWriter *open_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                               uint32_t channels, const format_t &format, Compression *compression,
+                               const exr_tiling_t &tiling)
+{
+	if (!can_write_strips(format))
+	{
+		return NULL;
+	}
+	if (!strcmp(format.ext, "exr"))
+	{
+		return exr_strip_writer(outputFile, output_scale, width, height, channels, format, compression, tiling);
+	}
+	if (!strcmp(format.ext, "aces"))
+	{
+		return aces_strip_writer(outputFile, output_scale, width, height, channels, format);
+	}
+	if (!strcmp(format.ext, "dpx"))
+	{
+		return dpx_strip_writer(outputFile, output_scale, width, height, channels, format);
+	}
+	return tiff_strip_writer(outputFile, output_scale, width, height, channels, format);
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_STRIP_INCLUDE)
+#define CTL_UTIL_CTLRENDER_STRIP_INCLUDE
+
+#include "main.hh"
+
+// Readers and writers that move an image through memory a band of
+// scanlines at a time, so that a frame never has to be held whole. Pixels
+// are interleaved floats with the same scaling read_image and write_image
+// apply: integral samples are divided (on read) or multiplied (on write)
+// by the scale, which defaults to the largest sample value, floating
+// point samples are multiplied (on read) or divided (on write) by it.
+
+class StripReader
+{
+	public:
+		StripReader();
+		virtual ~StripReader();
+
+		uint32_t width() const;
+		uint32_t height() const;
+		uint32_t channels() const;
+		const format_t &format() const;
+
+		// Reads rows [y, y + rows) into pixels, which holds
+		// rows * width() * channels() floats. Strips are read top to
+		// bottom.
+		virtual void read(uint32_t y, uint32_t rows, float *pixels) = 0;
+
+	protected:
+		uint32_t _width;
+		uint32_t _height;
+		uint32_t _channels;
+		format_t _format;
+};
+
+class StripWriter
+{
+	public:
+		virtual ~StripWriter();
+
+		// Appends the next rows scanlines, rows * width * channels floats.
+		virtual void write(uint32_t rows, const float *pixels) = 0;
+
+		// Completes the file once every scanline has been written.
+		virtual void finish() = 0;
+};
+
+// Return NULL when the file, or the format asked for, cannot be streamed,
+// in which case the frame goes through read_image and write_image as a
+// whole. Without alpha, readers that can leave the alpha channel of the
+// file out do, and have 3 channels.
+StripReader *open_strip_reader(const char *inputFile, float input_scale, bool alpha = true);
+bool can_write_strips(const format_t &format);
+StripWriter *open_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                               uint32_t channels, const format_t &format, Compression *compression,
+                               const exr_tiling_t &tiling = exr_tiling_t());
+
+// Per format, from exr_strip.cc, tiff_strip.cc and dpx_strip.cc.
+StripReader *exr_strip_reader(const char *inputFile, float input_scale, bool alpha = true);
+StripWriter *exr_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                              uint32_t channels, const format_t &format, Compression *compression,
+                              const exr_tiling_t &tiling = exr_tiling_t());
+StripWriter *aces_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                               uint32_t channels, const format_t &format);
+StripReader *tiff_strip_reader(const char *inputFile, float input_scale);
+StripWriter *tiff_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                               uint32_t channels, const format_t &format);
+StripReader *dpx_strip_reader(const char *inputFile, float input_scale);
+StripWriter *dpx_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                              uint32_t channels, const format_t &format);
+
+#endif
@@ -0,0 +1,404 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "tiff_convert.hh"
+#include "simd.hh"
+
+static void scalar_convert_uint8(const uint8_t *in, size_t count, float scale, float *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = in[i] * scale;
+	}
+}
+
+static void scalar_convert_uint16(const uint16_t *in, size_t count, float scale, float *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = in[i] * scale;
+	}
+}
+
+static void scalar_scale_float(const float *in, size_t count, float scale, float *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = in[i] * scale;
+	}
+}
+
+static void scalar_interleave_uint8(const float *in, size_t count, float scale, uint8_t *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = quantize_sample<uint8_t>(in[i] * scale, 255.0f);
+	}
+}
+
+static void scalar_interleave_uint16(const float *in, size_t count, float scale, uint16_t *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = quantize_sample<uint16_t>(in[i] * scale, 65535.0f);
+	}
+}
+
+static const tiff_kernels_t scalar_kernels =
+{
+	"scalar",
+	scalar_convert_uint8,
+	scalar_convert_uint16,
+	scalar_scale_float,
+	scalar_interleave_uint8,
+	scalar_interleave_uint16
+};
+
+#if defined(SIMD_X86)
+
+// Tails shorter than a vector go through the scalar loops.
+
+static SIMD_TARGET("sse4.1") void sse41_convert_uint8(const uint8_t *in, size_t count, float scale, float *out)
+{
+	__m128 s = _mm_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), s));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))), s));
+		_mm_storeu_ps(out + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))), s));
+		_mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))), s));
+	}
+	scalar_convert_uint8(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("sse4.1") void sse41_convert_uint16(const uint16_t *in, size_t count, float scale, float *out)
+{
+	__m128 s = _mm_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(v)), s));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8))), s));
+	}
+	scalar_convert_uint16(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("sse4.1") void sse41_scale_float(const float *in, size_t count, float scale, float *out)
+{
+	__m128 s = _mm_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), s));
+	}
+	scalar_scale_float(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("sse4.1") void sse41_interleave_uint8(const float *in, size_t count, float scale, uint8_t *out)
+{
+	__m128 s = _mm_set1_ps(scale);
+	__m128 max = _mm_set1_ps(255.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i lo = _mm_packus_epi32(sse_quantize(_mm_loadu_ps(in + i), s, max),
+		                              sse_quantize(_mm_loadu_ps(in + i + 4), s, max));
+		__m128i hi = _mm_packus_epi32(sse_quantize(_mm_loadu_ps(in + i + 8), s, max),
+		                              sse_quantize(_mm_loadu_ps(in + i + 12), s, max));
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(lo, hi));
+	}
+	scalar_interleave_uint8(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("sse4.1") void sse41_interleave_uint16(const float *in, size_t count, float scale, uint16_t *out)
+{
+	__m128 s = _mm_set1_ps(scale);
+	__m128 max = _mm_set1_ps(65535.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi32(sse_quantize(_mm_loadu_ps(in + i), s, max),
+		                                                         sse_quantize(_mm_loadu_ps(in + i + 4), s, max)));
+	}
+	scalar_interleave_uint16(in + i, count - i, scale, out + i);
+}
+
+static const tiff_kernels_t sse41_kernels =
+{
+	"sse4.1",
+	sse41_convert_uint8,
+	sse41_convert_uint16,
+	sse41_scale_float,
+	sse41_interleave_uint8,
+	sse41_interleave_uint16
+};
+
+// The 256 bit packs work within each 128 bit lane, the permute puts the
+// lanes back in order.
+static inline SIMD_TARGET("avx2") __m256i avx2_pack_uint16(__m256i a, __m256i b)
+{
+	return _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+}
+
+static SIMD_TARGET("avx2") void avx2_convert_uint8(const uint8_t *in, size_t count, float scale, float *out)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (in + i)));
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), s));
+	}
+	scalar_convert_uint8(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx2") void avx2_convert_uint16(const uint16_t *in, size_t count, float scale, float *out)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (in + i)));
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), s));
+	}
+	scalar_convert_uint16(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx2") void avx2_scale_float(const float *in, size_t count, float scale, float *out)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), s));
+	}
+	scalar_scale_float(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx2") void avx2_interleave_uint8(const float *in, size_t count, float scale, uint8_t *out)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	__m256 max = _mm256_set1_ps(255.0f);
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32)
+	{
+		__m256i lo = avx2_pack_uint16(avx2_quantize(_mm256_loadu_ps(in + i), s, max),
+		                              avx2_quantize(_mm256_loadu_ps(in + i + 8), s, max));
+		__m256i hi = avx2_pack_uint16(avx2_quantize(_mm256_loadu_ps(in + i + 16), s, max),
+		                              avx2_quantize(_mm256_loadu_ps(in + i + 24), s, max));
+		_mm256_storeu_si256((__m256i *) (out + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8));
+	}
+	scalar_interleave_uint8(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx2") void avx2_interleave_uint16(const float *in, size_t count, float scale, uint16_t *out)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	__m256 max = _mm256_set1_ps(65535.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm256_storeu_si256((__m256i *) (out + i), avx2_pack_uint16(avx2_quantize(_mm256_loadu_ps(in + i), s, max),
+		                                                            avx2_quantize(_mm256_loadu_ps(in + i + 8), s, max)));
+	}
+	scalar_interleave_uint16(in + i, count - i, scale, out + i);
+}
+
+static const tiff_kernels_t avx2_kernels =
+{
+	"avx2",
+	avx2_convert_uint8,
+	avx2_convert_uint16,
+	avx2_scale_float,
+	avx2_interleave_uint8,
+	avx2_interleave_uint16
+};
+
+static inline SIMD_TARGET("avx512f") __m512i avx512_quantize(__m512 v, __m512 scale, __m512 max)
+{
+	v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(v, scale), _mm512_setzero_ps()), max);
+	__m512i t = _mm512_cvttps_epi32(v);
+	__m512 fraction = _mm512_sub_ps(v, _mm512_cvtepi32_ps(t));
+	__mmask16 up = _mm512_cmp_ps_mask(fraction, _mm512_set1_ps(0.5f), _CMP_GE_OQ);
+	return _mm512_mask_add_epi32(t, up, t, _mm512_set1_epi32(1));
+}
+
+static SIMD_TARGET("avx512f") void avx512_convert_uint8(const uint8_t *in, size_t count, float scale, float *out)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i v = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (in + i)));
+		_mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_cvtepi32_ps(v), s));
+	}
+	scalar_convert_uint8(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx512f") void avx512_convert_uint16(const uint16_t *in, size_t count, float scale, float *out)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *) (in + i)));
+		_mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_cvtepi32_ps(v), s));
+	}
+	scalar_convert_uint16(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx512f") void avx512_scale_float(const float *in, size_t count, float scale, float *out)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(in + i), s));
+	}
+	scalar_scale_float(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx512f") void avx512_interleave_uint8(const float *in, size_t count, float scale, uint8_t *out)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	__m512 max = _mm512_set1_ps(255.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm_storeu_si128((__m128i *) (out + i), _mm512_cvtepi32_epi8(avx512_quantize(_mm512_loadu_ps(in + i), s, max)));
+	}
+	scalar_interleave_uint8(in + i, count - i, scale, out + i);
+}
+
+static SIMD_TARGET("avx512f") void avx512_interleave_uint16(const float *in, size_t count, float scale, uint16_t *out)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	__m512 max = _mm512_set1_ps(65535.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm256_storeu_si256((__m256i *) (out + i), _mm512_cvtepi32_epi16(avx512_quantize(_mm512_loadu_ps(in + i), s, max)));
+	}
+	scalar_interleave_uint16(in + i, count - i, scale, out + i);
+}
+
+static const tiff_kernels_t avx512_kernels =
+{
+	"avx512",
+	avx512_convert_uint8,
+	avx512_convert_uint16,
+	avx512_scale_float,
+	avx512_interleave_uint8,
+	avx512_interleave_uint16
+};
+
+#endif
+
+const tiff_kernels_t *tiff_kernels_for(tiff_isa_t isa)
+{
+#if defined(SIMD_X86)
+	__builtin_cpu_init();
+	switch (isa)
+	{
+		case TIFF_ISA_SSE41:
+			return __builtin_cpu_supports("sse4.1") ? &sse41_kernels : NULL;
+		case TIFF_ISA_AVX2:
+			return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+		case TIFF_ISA_AVX512:
+			return __builtin_cpu_supports("avx512f") ? &avx512_kernels : NULL;
+		default:
+			break;
+	}
+#endif
+	return isa == TIFF_ISA_SCALAR ? &scalar_kernels : NULL;
+}
+
+static const tiff_kernels_t *best_tiff_kernels()
+{
+	const tiff_isa_t order[] = { TIFF_ISA_AVX512, TIFF_ISA_AVX2, TIFF_ISA_SSE41 };
+
+	for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+	{
+		const tiff_kernels_t *kernels = tiff_kernels_for(order[i]);
+		if (kernels != NULL)
+		{
+			return kernels;
+		}
+	}
+	return &scalar_kernels;
+}
+
+const tiff_kernels_t &tiff_kernels()
+{
+	static const tiff_kernels_t *kernels = best_tiff_kernels();
+	return *kernels;
+}
@@ -0,0 +1,275 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "strip.hh"
+#include "tiff_convert.hh"
+#include <Iex.h>
+#include <tiffio.h>
+#include <stdio.h>
+#include <vector>
+
+static bool is_tiff_file(const char *inputFile)
+{
+	unsigned char magic[4];
+	FILE *file = fopen(inputFile, "rb");
+	bool is_tiff = false;
+
+	if (file != NULL)
+	{
+		is_tiff = fread(magic, 1, 4, file) == 4 &&
+		          ((magic[0] == 'I' && magic[1] == 'I' && magic[2] == 42 && magic[3] == 0) ||
+		           (magic[0] == 'M' && magic[1] == 'M' && magic[2] == 0 && magic[3] == 42));
+		fclose(file);
+	}
+	return is_tiff;
+}
+
+class TiffStripReader: public StripReader
+{
+	public:
+		TiffStripReader(TIFF *tif, float input_scale, uint16_t bps, uint16_t sample_format)
+			: _tif(tif), _bps(bps), _float(sample_format == SAMPLEFORMAT_IEEEFP), _kernels(tiff_kernels())
+		{
+			uint32_t width, height;
+			uint16_t spp;
+
+			TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+			TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+			TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+
+			_width = width;
+			_height = height;
+			_channels = spp;
+			_format = format_t("tiff", bps);
+			if (_float)
+			{
+				_scale = input_scale != 0.0 ? input_scale : 1.0;
+			}
+			else
+			{
+				_scale = 1.0 / (input_scale != 0.0 ? input_scale : (float) ((1 << bps) - 1));
+			}
+			_scanline.resize(TIFFScanlineSize(tif));
+		}
+
+		virtual ~TiffStripReader()
+		{
+			TIFFClose(_tif);
+		}
+
+		virtual void read(uint32_t y, uint32_t rows, float *pixels)
+		{
+			size_t count = (size_t) _width * _channels;
+
+			for (uint32_t row = y; row < y + rows; row++, pixels += count)
+			{
+				if (TIFFReadScanline(_tif, &_scanline[0], row) < 0)
+				{
+					THROW(Iex::InputExc, "Unable to read scanline " << row << " of the tiff file");
+				}
+				if (_bps == 8)
+				{
+					_kernels.convert_uint8(&_scanline[0], count, _scale, pixels);
+				}
+				else if (_bps == 16)
+				{
+					_kernels.convert_uint16((const uint16_t *) &_scanline[0], count, _scale, pixels);
+				}
+				else
+				{
+					_kernels.scale_float((const float *) &_scanline[0], count, _scale, pixels);
+				}
+			}
+		}
+
+	private:
+		TIFF *_tif;
+		uint16_t _bps;
+		bool _float;
+		float _scale;
+		const tiff_kernels_t &_kernels;
+		std::vector<uint8_t> _scanline;
+};
+
+class TiffStripWriter: public StripWriter
+{
+	public:
+		TiffStripWriter(TIFF *tif, float output_scale, uint32_t width, uint32_t height, uint32_t channels, uint16_t bps)
+			: _tif(tif), _width(width), _channels(channels), _bps(bps), _row(0), _kernels(tiff_kernels())
+		{
+			TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+			TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+			TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, (uint16_t) channels);
+			TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, bps);
+			TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, bps == 32 ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+			TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, channels < 3 ? PHOTOMETRIC_MINISBLACK : PHOTOMETRIC_RGB);
+			TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+			TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+			TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+			if (channels == 4)
+			{
+				uint16_t extra = EXTRASAMPLE_UNASSALPHA;
+				TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+			}
+			TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+
+			if (bps == 32)
+			{
+				_scale = 1.0 / (output_scale != 0.0 ? output_scale : 1.0);
+			}
+			else
+			{
+				_scale = output_scale != 0.0 ? output_scale : (float) ((1 << bps) - 1);
+			}
+			_scanline.resize(TIFFScanlineSize(tif));
+		}
+
+		virtual ~TiffStripWriter()
+		{
+			if (_tif != NULL)
+			{
+				TIFFClose(_tif);
+			}
+		}
+
+		virtual void write(uint32_t rows, const float *pixels)
+		{
+			size_t count = (size_t) _width * _channels;
+
+			for (uint32_t r = 0; r < rows; r++, _row++, pixels += count)
+			{
+				if (_bps == 8)
+				{
+					_kernels.interleave_uint8(pixels, count, _scale, &_scanline[0]);
+				}
+				else if (_bps == 16)
+				{
+					_kernels.interleave_uint16(pixels, count, _scale, (uint16_t *) &_scanline[0]);
+				}
+				else
+				{
+					_kernels.scale_float(pixels, count, _scale, (float *) &_scanline[0]);
+				}
+				if (TIFFWriteScanline(_tif, &_scanline[0], _row) < 0)
+				{
+					THROW(Iex::IoExc, "Unable to write scanline " << _row << " of the tiff file");
+				}
+			}
+		}
+
+		virtual void finish()
+		{
+			TIFFClose(_tif);
+			_tif = NULL;
+		}
+
+	private:
+		TIFF *_tif;
+		uint32_t _width;
+		uint32_t _channels;
+		uint16_t _bps;
+		float _scale;
+		uint32_t _row;
+		const tiff_kernels_t &_kernels;
+		std::vector<uint8_t> _scanline;
+};
+
+StripReader *tiff_strip_reader(const char *inputFile, float input_scale)
+{
+	uint16_t bps, spp, sample_format, planar, orientation;
+	uint16_t photometric = 0;
+	TIFF *tif;
+
+	if (!is_tiff_file(inputFile) || (tif = TIFFOpen(inputFile, "r")) == NULL)
+	{
+		return NULL;
+	}
+
+	TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &sample_format);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &orientation);
+	// Photometric has no default, a file without it is left alone too.
+	TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric);
+
+	// Tiled, planar, bottom up and odd bit depth files are left to
+	// tiff_read, and so are palette, min-is-white, CMYK and YCbCr ones,
+	// whose samples are not the RGB or grey values this reader returns.
+	// Compressed strips are streamed too: libtiff decodes them for
+	// scanlines read in order, which is all this reader asks of it.
+	bool streamable = !TIFFIsTiled(tif) && planar == PLANARCONFIG_CONTIG && spp != 2 && spp <= 4 &&
+	                  orientation == ORIENTATION_TOPLEFT &&
+	                  ((photometric == PHOTOMETRIC_RGB && spp >= 3) || (photometric == PHOTOMETRIC_MINISBLACK && spp == 1)) &&
+	                  ((sample_format == SAMPLEFORMAT_UINT && (bps == 8 || bps == 16)) ||
+	                   (sample_format == SAMPLEFORMAT_IEEEFP && bps == 32));
+	if (!streamable)
+	{
+		TIFFClose(tif);
+		return NULL;
+	}
+	return new TiffStripReader(tif, input_scale, bps, sample_format);
+}
+
+StripWriter *tiff_strip_writer(const char *outputFile, float output_scale, uint32_t width, uint32_t height,
+                               uint32_t channels, const format_t &format)
+{
+	TIFF *tif = TIFFOpen(outputFile, "w");
+
+	if (tif == NULL)
+	{
+		THROW(Iex::IoExc, "Unable to open the tiff file " << outputFile << " for writing");
+	}
+	return new TiffStripWriter(tif, output_scale, width, height, channels, format.bps);
+}
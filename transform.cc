@@ -0,0 +1,1548 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#include "transform.hh"
+#include "lut.hh"
+#include "strip.hh"
+#include "buffer_pool.hh"
+#include <CtlSimdInterpreter.h>
+#include <CtlFunctionCall.h>
+#include <CtlStdType.h>
+#include <Iex.h>
+#include <IlmThreadPool.h>
+#include <IlmThreadMutex.h>
+#include <ImfThreading.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include "exr_file.hh"
+#include "tiff_file.hh"
+#include "dpx_file.hh"
+#include "aces_file.hh"
+
+CTLResult::CTLResult() : varying(true)
+{
+}
+
+CTLResult::~CTLResult()
+{
+}
+
+transform_stats_t::transform_stats_t()
+	: pixels(0.0), read(0.0), mkresult(0.0), lut(0.0), mkimage(0.0), write(0.0), total(0.0),
+	  bytes_read(0.0), bytes_written(0.0), cached(false)
+{
+}
+
+transform_options_t::transform_options_t() : strip_rows(0), threads(0)
+{
+}
+
+double wall_clock()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+double file_size(const char *filename)
+{
+	struct stat file_status;
+	return stat(filename, &file_status) < 0 ? 0.0 : (double) file_status.st_size;
+}
+
+// Maps 'R', 'rIn', 'rOut' (and the G, B and A equivalents, in either
+// case) onto an index into an RGBA framebuffer. This is what lets the
+// 'rOut' of one script feed the 'rIn' of the next. Anything else is treated
+// as a parameter and returns -1.
+static int channel_index(const std::string &name)
+{
+	if (name.empty())
+	{
+		return -1;
+	}
+	if (name.size() != 1 && strcasecmp(name.c_str() + 1, "in") && strcasecmp(name.c_str() + 1, "out"))
+	{
+		return -1;
+	}
+	switch (name[0])
+	{
+		case 'r': case 'R': return 0;
+		case 'g': case 'G': return 1;
+		case 'b': case 'B': return 2;
+		case 'a': case 'A': return 3;
+	}
+	return -1;
+}
+
+static bool ctl_names_match(const std::string &a, const std::string &b)
+{
+	int a_channel = channel_index(a);
+	int b_channel = channel_index(b);
+
+	if (a_channel >= 0 && b_channel >= 0)
+	{
+		return a_channel == b_channel;
+	}
+	return a == b;
+}
+
+static CTLResults::const_iterator find_ctl_result(const CTLResults &ctl_results, const std::string &name)
+{
+	CTLResults::const_iterator i;
+
+	for (i = ctl_results.begin(); i != ctl_results.end(); i++)
+	{
+		if (ctl_names_match((*i)->data->name(), name))
+		{
+			break;
+		}
+	}
+	return i;
+}
+
+static std::string module_name_for(const char *filename)
+{
+	const char *start = strrchr(filename, '/');
+	start = start == NULL ? filename : start + 1;
+	const char *dot = strrchr(start, '.');
+
+	return dot == NULL ? std::string(start) : std::string(start, dot - start);
+}
+
+static bool read_text_file(const char *filename, std::string *text)
+{
+	FILE *file = fopen(filename, "rb");
+	char buffer[65536];
+	size_t n;
+
+	if (file == NULL)
+	{
+		return false;
+	}
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text->append(buffer, n);
+	}
+	fclose(file);
+	return true;
+}
+
+static bool is_identifier_char(char c)
+{
+	return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+// The names of the 'import "<name>";' statements of a CTL source. Comments
+// and other string literals are skipped.
+static void ctl_import_names(const std::string &source, std::vector<std::string> *names)
+{
+	size_t i = 0;
+
+	while (i < source.size())
+	{
+		if (source.compare(i, 2, "//") == 0)
+		{
+			i = source.find('\n', i);
+		}
+		else if (source.compare(i, 2, "/*") == 0)
+		{
+			i = source.find("*/", i + 2);
+			i = i == std::string::npos ? i : i + 2;
+		}
+		else if (source[i] == '"')
+		{
+			for (i++; i < source.size() && source[i] != '"'; i++)
+			{
+				i += source[i] == '\\' ? 1 : 0;
+			}
+			i++;
+		}
+		else if (source.compare(i, 6, "import") == 0 && (i == 0 || !is_identifier_char(source[i - 1])) &&
+		         (i + 6 == source.size() || !is_identifier_char(source[i + 6])))
+		{
+			size_t quote = source.find_first_not_of(" \t\r\n", i + 6);
+			size_t end = quote == std::string::npos || source[quote] != '"' ? std::string::npos : source.find('"', quote + 1);
+
+			if (end == std::string::npos)
+			{
+				i += 6;
+				continue;
+			}
+			names->push_back(source.substr(quote + 1, end - quote - 1));
+			i = end + 1;
+		}
+		else
+		{
+			i++;
+		}
+		if (i == std::string::npos)
+		{
+			break;
+		}
+	}
+}
+
+static void add_ctl_module_imports(const std::string &resolved, std::vector<std::string> *imports)
+{
+	std::string source;
+	std::vector<std::string> names;
+	std::vector<std::string> directories;
+	const char *module_path = getenv("CTL_MODULE_PATH");
+
+	if (!read_text_file(resolved.c_str(), &source))
+	{
+		return;
+	}
+	ctl_import_names(source, &names);
+	if (names.empty())
+	{
+		return;
+	}
+
+	directories.push_back(resolved.substr(0, resolved.rfind('/') + 1));
+	for (const char *p = module_path; p != NULL && *p != 0; )
+	{
+		const char *colon = strchr(p, ':');
+		std::string directory = colon == NULL ? std::string(p) : std::string(p, colon - p);
+		if (!directory.empty())
+		{
+			directories.push_back(directory + "/");
+		}
+		p = colon == NULL ? NULL : colon + 1;
+	}
+	directories.push_back("./");
+
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		for (size_t d = 0; d < directories.size(); d++)
+		{
+			char candidate[PATH_MAX];
+			std::string path = directories[d] + names[n] + ".ctl";
+
+			if (realpath(path.c_str(), candidate) != NULL &&
+			    std::find(imports->begin(), imports->end(), std::string(candidate)) == imports->end())
+			{
+				imports->push_back(candidate);
+				add_ctl_module_imports(candidate, imports);
+			}
+		}
+	}
+}
+
+std::vector<std::string> ctl_module_imports(const char *filename)
+{
+	char resolved[PATH_MAX];
+	std::vector<std::string> imports;
+
+	if (realpath(filename, resolved) != NULL)
+	{
+		imports.push_back(resolved);
+		add_ctl_module_imports(resolved, &imports);
+		imports.erase(imports.begin());
+	}
+	return imports;
+}
+
+// A file by modification time and size, to tell when it has changed.
+struct file_stamp_t
+{
+	std::string path;
+	time_t mtime;
+	off_t size;
+};
+
+static file_stamp_t file_stamp(const std::string &path)
+{
+	struct stat file_status;
+	file_stamp_t stamp;
+
+	stamp.path = path;
+	stamp.mtime = 0;
+	stamp.size = -1;
+	if (stat(path.c_str(), &file_status) >= 0)
+	{
+		stamp.mtime = file_status.st_mtime;
+		stamp.size = file_status.st_size;
+	}
+	return stamp;
+}
+
+// Loading a module parses and compiles the CTL source, which for the
+// ACES RRT and ODTs costs far more than running them over a small image.
+// Interpreters are therefore kept between calls, keyed by the resolved
+// path of the file and reloaded when the modification time or size of it,
+// or of any module it imports, changes.
+//
+// Every thread evaluating a module needs its own function call. Idle ones
+// are kept with the module and handed out by acquire_ctl_function_calls.
+struct ctl_module_t
+{
+	time_t mtime;
+	off_t size;
+	std::vector<file_stamp_t> imports;
+	std::string function_name;
+	Ctl::SimdInterpreter *interpreter;
+	std::vector<Ctl::FunctionCallPtr> idle;
+	int users;
+	bool flushed;
+};
+typedef std::map<std::string, ctl_module_t *> CTLModules;
+
+static CTLModules ctl_modules;
+static IlmThread::Mutex ctl_modules_mutex;
+static IlmThread::ThreadPool *ctl_thread_pool = NULL;
+
+static void delete_ctl_module(ctl_module_t *module)
+{
+	// The function calls refer to the interpreter and must go first.
+	module->idle.clear();
+	delete module->interpreter;
+	delete module;
+}
+
+static ctl_module_t *load_ctl_module(const char *filename)
+{
+	char resolved[PATH_MAX];
+	struct stat file_status;
+	std::string key;
+	CTLModules::iterator i;
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	if (realpath(filename, resolved) == NULL || stat(resolved, &file_status) < 0)
+	{
+		THROW(Iex::ArgExc, "unable to find ctl file " << filename << ".");
+	}
+	key = resolved;
+
+	i = ctl_modules.find(key);
+	if (i != ctl_modules.end())
+	{
+		bool changed = i->second->mtime != file_status.st_mtime || i->second->size != file_status.st_size;
+		for (size_t k = 0; k < i->second->imports.size() && !changed; k++)
+		{
+			file_stamp_t stamp = file_stamp(i->second->imports[k].path);
+			changed = stamp.mtime != i->second->imports[k].mtime || stamp.size != i->second->imports[k].size;
+		}
+		if (!changed)
+		{
+			i->second->users++;
+			return i->second;
+		}
+		if (i->second->users == 0)
+		{
+			delete_ctl_module(i->second);
+		}
+		else
+		{
+			i->second->flushed = true;
+		}
+		ctl_modules.erase(i);
+	}
+
+	ctl_module_t *module = new ctl_module_t;
+	Ctl::FunctionCallPtr fn;
+
+	module->mtime = file_status.st_mtime;
+	module->size = file_status.st_size;
+	std::vector<std::string> imports = ctl_module_imports(resolved);
+	for (size_t k = 0; k < imports.size(); k++)
+	{
+		module->imports.push_back(file_stamp(imports[k]));
+	}
+	module->interpreter = new Ctl::SimdInterpreter();
+	module->users = 1;
+	module->flushed = false;
+	try
+	{
+		module->interpreter->loadFile(resolved);
+		try
+		{
+			module->function_name = "main";
+			fn = module->interpreter->newFunctionCall(module->function_name);
+		}
+		catch (const Iex::ArgExc &e)
+		{
+			module->function_name = module_name_for(filename);
+			fn = module->interpreter->newFunctionCall(module->function_name);
+		}
+
+		if (fn->returnValue()->type().cast<Ctl::VoidType>().refcount() == 0)
+		{
+			THROW(Iex::ArgExc, "CTL main (or <module_name>) function must return a 'void'");
+		}
+	}
+	catch (...)
+	{
+		fn = Ctl::FunctionCallPtr();
+		delete_ctl_module(module);
+		throw;
+	}
+
+	module->idle.push_back(fn);
+	ctl_modules[key] = module;
+	return module;
+}
+
+static void release_ctl_module(ctl_module_t *module)
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	if (--module->users == 0 && module->flushed)
+	{
+		delete_ctl_module(module);
+	}
+}
+
+static void acquire_ctl_function_calls(ctl_module_t *module, size_t count, std::vector<Ctl::FunctionCallPtr> *fns)
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	while (fns->size() < count && !module->idle.empty())
+	{
+		fns->push_back(module->idle.back());
+		module->idle.pop_back();
+	}
+	while (fns->size() < count)
+	{
+		fns->push_back(module->interpreter->newFunctionCall(module->function_name));
+	}
+}
+
+static void return_ctl_function_calls(ctl_module_t *module, std::vector<Ctl::FunctionCallPtr> *fns)
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	module->idle.insert(module->idle.end(), fns->begin(), fns->end());
+	fns->clear();
+}
+
+void flush_ctl_module_cache()
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	for (CTLModules::iterator i = ctl_modules.begin(); i != ctl_modules.end(); i++)
+	{
+		// Modules still running elsewhere go when their last user is done.
+		if (i->second->users == 0)
+		{
+			delete_ctl_module(i->second);
+		}
+		else
+		{
+			i->second->flushed = true;
+		}
+	}
+	ctl_modules.clear();
+}
+
+void release_ctl_thread_pool()
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	delete ctl_thread_pool;
+	ctl_thread_pool = NULL;
+}
+
+// Frames of a batch, and jobs running side by side, share the pool, so it
+// is created and resized under the module lock. It only grows: a chain is
+// split into no more tasks than its own workers, so a job never runs on
+// more threads than its budget, and shrinking the pool under a running
+// job would only stall it.
+static IlmThread::ThreadPool *get_ctl_thread_pool(int workers)
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+
+	if (ctl_thread_pool == NULL)
+	{
+		ctl_thread_pool = new IlmThread::ThreadPool(workers);
+	}
+	else if (ctl_thread_pool->numThreads() < workers)
+	{
+		ctl_thread_pool->setNumThreads(workers);
+	}
+	return ctl_thread_pool;
+}
+
+int ctl_worker_count(int threads)
+{
+	return threads > 0 ? threads : hardware_threads();
+}
+
+int hardware_threads()
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	return processors > 0 ? (int) processors : 1;
+}
+
+// The codec pool is global to IlmImf, so it is only resized when its
+// share changes: resizing waits for the threads being stopped.
+static int exr_threads = -1;
+
+int set_thread_budget(int threads, bool pipelined)
+{
+	int budget = threads > 0 ? threads : hardware_threads();
+	int codec = budget;
+
+	if (budget == 1)
+	{
+		// Files are then encoded and decoded on the calling thread.
+		codec = 0;
+	}
+	else if (pipelined)
+	{
+		// A third to the codecs, the rest to evaluation.
+		codec = std::max(budget / 3, 1);
+	}
+
+	IlmThread::Lock lock(ctl_modules_mutex);
+	if (codec != exr_threads)
+	{
+		Imf::setGlobalThreadCount(codec);
+		exr_threads = codec;
+	}
+	return pipelined ? std::max(budget - codec, 1) : budget;
+}
+
+int exr_thread_count()
+{
+	IlmThread::Lock lock(ctl_modules_mutex);
+	return exr_threads < 0 ? Imf::globalThreadCount() : exr_threads;
+}
+
+CTLResultPtr mkresult(const char *name, const ctl::dpx::fb<float> &image_buffer, size_t offset)
+{
+	size_t count = image_buffer.pixels();
+	CTLResultPtr ctl_result = buffer_pool().acquire_channel(name, count);
+
+	ctl_result->data->set(image_buffer.ptr() + offset, image_buffer.depth() * sizeof(float), 0, count);
+
+	return ctl_result;
+}
+
+void add_parameter_value_to_ctl_results(CTLResults *ctl_results, const ctl_parameter_t &parameter)
+{
+	CTLResults::iterator i;
+	CTLResultPtr ctl_result = new CTLResult();
+	Ctl::DataTypePtr type = new Ctl::StdFloatType();
+
+	// A later definition (local over global) replaces an earlier one.
+	for (i = ctl_results->begin(); i != ctl_results->end(); i++)
+	{
+		if ((*i)->data->name() == parameter.name)
+		{
+			ctl_results->erase(i);
+			break;
+		}
+	}
+
+	if (parameter.count > 1)
+	{
+		type = new Ctl::StdArrayType(type, parameter.count);
+	}
+	Ctl::DataArgPtr data = new Ctl::DataArg(parameter.name, type, 1);
+	if (parameter.count > 1)
+	{
+		for (int j = 0; j < parameter.count; j++)
+		{
+			data->set(parameter.value + j, sizeof(float), 0, 1, "%d", j);
+		}
+	}
+	else
+	{
+		data->set(parameter.value, sizeof(float), 0, 1);
+	}
+	ctl_result->data = data;
+	ctl_result->varying = false;
+
+	ctl_results->push_back(ctl_result);
+}
+
+static void store_ctl_function_argument(const CTLResultPtr &ctl_result, const Ctl::FunctionArgPtr &arg, size_t offset, size_t count)
+{
+	if (arg->isVarying())
+	{
+		ctl_result->data->copy(arg, 0, offset, count);
+	}
+	else
+	{
+		for (size_t j = 0; j < count; j++)
+		{
+			ctl_result->data->copy(arg, 0, offset + j, 1);
+		}
+	}
+}
+
+// Where a varying input of a stage comes from: an output of an earlier
+// stage (stage >= 0), or a frame sized result.
+struct ctl_binding_t
+{
+	size_t arg;
+	int stage;
+	size_t output;
+	CTLResultPtr result;
+};
+
+// One operation of a chain, with a function call for each worker.
+struct ctl_stage_t
+{
+	const ctl_operation_t *operation;
+	ctl_module_t *module;
+	std::vector<Ctl::FunctionCallPtr> fns;
+	std::vector<ctl_binding_t> bindings;
+};
+
+// A frame sized result of the chain, taken from the last stage that
+// produced it.
+struct ctl_product_t
+{
+	int stage;
+	size_t output;
+	CTLResultPtr result;
+};
+
+// What the workers evaluating a chain share. Each worker has its own
+// function calls and range of samples and writes only that range of the
+// products, so apart from reporting an error they need no locking.
+struct ctl_chain_t
+{
+	std::vector<ctl_stage_t> stages;
+	std::vector<ctl_product_t> products;
+	size_t block;
+	size_t count;
+	// Per worker and stage, when timed.
+	bool timed;
+	std::vector<std::vector<double> > seconds;
+	IlmThread::Mutex mutex;
+	std::string error;
+};
+
+static bool find_ctl_stage_output(const ctl_stage_t &stage, const std::string &name, size_t *output)
+{
+	const Ctl::FunctionCallPtr &fn = stage.fns[0];
+
+	for (size_t o = 0; o < fn->numOutputArgs(); o++)
+	{
+		if (ctl_names_match(fn->outputArg(o)->name(), name))
+		{
+			*output = o;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Finds the source of every input of stage k, in the order the results
+// list would have had after the stages before it: local parameters, then
+// the newest stage output, then the frame and the global parameters.
+// Inputs that do not change from one block to the next are bound here
+// once, the others become bindings.
+static void bind_ctl_stage(ctl_chain_t *chain, size_t k, const CTLResults &ctl_results, bool verbose)
+{
+	ctl_stage_t &stage = chain->stages[k];
+	const Ctl::FunctionCallPtr &fn = stage.fns[0];
+	CTLResults locals;
+
+	for (CTLParameters::const_iterator p = stage.operation->local.begin(); p != stage.operation->local.end(); p++)
+	{
+		add_parameter_value_to_ctl_results(&locals, *p);
+	}
+
+	for (size_t i = 0; i < fn->numInputArgs(); i++)
+	{
+		std::string name = fn->inputArg(i)->name();
+		ctl_binding_t binding;
+		CTLResultPtr source;
+		bool found = false;
+		const char *note;
+
+		binding.arg = i;
+		binding.stage = -1;
+		binding.output = 0;
+
+		for (CTLResults::const_iterator r = locals.begin(); !found && r != locals.end(); r++)
+		{
+			if ((*r)->data->name() == name)
+			{
+				source = *r;
+				found = true;
+			}
+		}
+		for (int j = (int) k - 1; !found && j >= 0; j--)
+		{
+			if (find_ctl_stage_output(chain->stages[j], name, &binding.output))
+			{
+				binding.stage = j;
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			CTLResults::const_iterator r = find_ctl_result(ctl_results, name);
+			if (r != ctl_results.end())
+			{
+				source = *r;
+				found = true;
+			}
+		}
+
+		if (binding.stage >= 0 || (found && source->varying))
+		{
+			binding.result = source;
+			stage.bindings.push_back(binding);
+			note = binding.stage >= 0 ? " (from an earlier script)" : " (varying)";
+		}
+		else
+		{
+			for (size_t w = 0; w < stage.fns.size(); w++)
+			{
+				Ctl::FunctionArgPtr arg = stage.fns[w]->inputArg(i);
+
+				if (found)
+				{
+					arg->setVarying(false);
+					arg->copy(source->data, 0, 0, 1);
+				}
+				else if (arg->hasDefaultValue())
+				{
+					arg->setDefaultValue();
+				}
+				else
+				{
+					THROW(Iex::ArgExc, "CTL parameter '" << name << "' not specified on the command line and does not have a default value.");
+				}
+			}
+			note = found ? "" : " (defaulted)";
+		}
+
+		if (verbose)
+		{
+			fprintf(stderr, "%18s: %s\n", name.c_str(), note);
+		}
+	}
+}
+
+// Samples taken through the whole chain at a time. Every argument of every
+// stage is meant to fit the second level cache for one block, so what one
+// stage writes is still there when the next one reads it.
+static size_t ctl_block_samples(const ctl_chain_t &chain)
+{
+	size_t max_samples = (size_t) -1;
+	size_t args = 0;
+	long cache = 256 * 1024;
+
+	for (size_t k = 0; k < chain.stages.size(); k++)
+	{
+		const ctl_stage_t &stage = chain.stages[k];
+		max_samples = std::min(max_samples, stage.module->interpreter->maxSamples());
+		args += stage.fns[0]->numInputArgs() + stage.fns[0]->numOutputArgs();
+	}
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+	if (sysconf(_SC_LEVEL2_CACHE_SIZE) > 0)
+	{
+		cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	}
+#endif
+
+	// Below a few hundred samples the cost of a call to the interpreter
+	// outweighs the cache misses saved.
+	size_t block = std::max(cache / (std::max(args, (size_t) 1) * sizeof(float)), (size_t) 512);
+	return std::min(block, max_samples);
+}
+
+static void run_ctl_chain_range(ctl_chain_t *chain, size_t worker, size_t begin, size_t end)
+{
+	size_t this_count;
+
+	for (size_t offset = begin; offset < end; offset += this_count)
+	{
+		this_count = std::min(end - offset, chain->block);
+
+		for (size_t k = 0; k < chain->stages.size(); k++)
+		{
+			const ctl_stage_t &stage = chain->stages[k];
+			const Ctl::FunctionCallPtr &fn = stage.fns[worker];
+			double start = chain->timed ? wall_clock() : 0.0;
+
+			for (size_t b = 0; b < stage.bindings.size(); b++)
+			{
+				const ctl_binding_t &binding = stage.bindings[b];
+				Ctl::FunctionArgPtr arg = fn->inputArg(binding.arg);
+
+				if (binding.stage < 0)
+				{
+					arg->setVarying(true);
+					arg->copy(binding.result->data, offset, 0, this_count);
+					continue;
+				}
+
+				// Straight from the earlier stage's output argument, which
+				// holds this block until that stage runs again.
+				Ctl::FunctionArgPtr source = chain->stages[binding.stage].fns[worker]->outputArg(binding.output);
+				if (source->isVarying())
+				{
+					arg->setVarying(true);
+					arg->copy(source, 0, 0, this_count);
+				}
+				else
+				{
+					arg->setVarying(false);
+					arg->copy(source, 0, 0, 1);
+				}
+			}
+
+			fn->callFunction(this_count);
+
+			if (chain->timed)
+			{
+				chain->seconds[worker][k] += wall_clock() - start;
+			}
+		}
+
+		for (size_t p = 0; p < chain->products.size(); p++)
+		{
+			const ctl_product_t &product = chain->products[p];
+			store_ctl_function_argument(product.result, chain->stages[product.stage].fns[worker]->outputArg(product.output), offset, this_count);
+		}
+	}
+}
+
+class CTLTask: public IlmThread::Task
+{
+	public:
+		CTLTask(IlmThread::TaskGroup *group, ctl_chain_t *chain, size_t worker, size_t begin, size_t end)
+			: IlmThread::Task(group), _chain(chain), _worker(worker), _begin(begin), _end(end)
+		{
+		}
+
+		virtual void execute()
+		{
+			try
+			{
+				run_ctl_chain_range(_chain, _worker, _begin, _end);
+			}
+			catch (std::exception &e)
+			{
+				IlmThread::Lock lock(_chain->mutex);
+				if (_chain->error.empty())
+				{
+					_chain->error = e.what();
+				}
+			}
+		}
+
+	private:
+		ctl_chain_t *_chain;
+		size_t _worker;
+		size_t _begin;
+		size_t _end;
+};
+
+static void release_ctl_chain(ctl_chain_t *chain)
+{
+	for (size_t k = 0; k < chain->stages.size(); k++)
+	{
+		return_ctl_function_calls(chain->stages[k].module, &chain->stages[k].fns);
+		release_ctl_module(chain->stages[k].module);
+	}
+	chain->stages.clear();
+}
+
+void run_ctl_chain(const CTLOperations &ctl_operations, CTLResults *ctl_results, size_t count, int threads, std::vector<double> *operation_seconds)
+{
+	ctl_chain_t chain;
+	size_t workers;
+	size_t blocks;
+	size_t k, i;
+
+	if (ctl_operations.empty())
+	{
+		return;
+	}
+
+	try
+	{
+		for (CTLOperations::const_iterator op = ctl_operations.begin(); op != ctl_operations.end(); op++)
+		{
+			ctl_stage_t stage;
+			stage.operation = &*op;
+			stage.module = load_ctl_module(op->filename);
+			chain.stages.push_back(stage);
+			acquire_ctl_function_calls(stage.module, 1, &chain.stages.back().fns);
+		}
+
+		chain.count = count;
+		chain.block = ctl_block_samples(chain);
+		blocks = (count + chain.block - 1) / chain.block;
+		workers = std::max(std::min((size_t) ctl_worker_count(threads), blocks), (size_t) 1);
+		chain.timed = operation_seconds != NULL;
+		chain.seconds.assign(workers, std::vector<double>(chain.stages.size(), 0.0));
+
+		for (k = 0; k < chain.stages.size(); k++)
+		{
+			ctl_stage_t &stage = chain.stages[k];
+
+			acquire_ctl_function_calls(stage.module, workers, &stage.fns);
+
+			if (verbosity > 1)
+			{
+				fprintf(stderr, "   ctl script file: %s\n", stage.operation->filename);
+				fprintf(stderr, "     function name: %s\n", stage.fns[0]->name().c_str());
+				fprintf(stderr, "   input arguments:\n");
+			}
+			bind_ctl_stage(&chain, k, *ctl_results, verbosity > 1);
+
+			if (verbosity > 1)
+			{
+				fprintf(stderr, "  output arguments:\n");
+			}
+			for (i = 0; i < stage.fns[0]->numOutputArgs(); i++)
+			{
+				Ctl::FunctionArgPtr arg = stage.fns[0]->outputArg(i);
+
+				if (arg->type().cast<Ctl::FloatType>().refcount() == 0 && arg->type().cast<Ctl::HalfType>().refcount() == 0)
+				{
+					THROW(Iex::ArgExc, "CTL script not providing half or float as the output data type.");
+				}
+				if (verbosity > 1)
+				{
+					fprintf(stderr, "%18s: %s\n", arg->name().c_str(), "");
+				}
+			}
+		}
+
+		// Only what is left once the chain is done gets a frame sized
+		// buffer, newest first as the results list would have it. These are
+		// created up front so the workers only ever write into them.
+		CTLResults outputs;
+		for (int j = (int) chain.stages.size() - 1; j >= 0; j--)
+		{
+			const Ctl::FunctionCallPtr &fn = chain.stages[j].fns[0];
+			size_t later = outputs.size();
+
+			for (i = 0; i < fn->numOutputArgs(); i++)
+			{
+				std::string name = fn->outputArg(i)->name();
+				bool shadowed = false;
+				CTLResults::const_iterator r = outputs.begin();
+
+				for (size_t n = 0; n < later; n++, r++)
+				{
+					shadowed = shadowed || ctl_names_match((*r)->data->name(), name);
+				}
+				if (shadowed)
+				{
+					continue;
+				}
+
+				ctl_product_t product;
+				product.stage = j;
+				product.output = i;
+				product.result = buffer_pool().acquire_channel(name, count);
+				chain.products.push_back(product);
+				outputs.push_back(product.result);
+			}
+		}
+
+		if (workers <= 1)
+		{
+			run_ctl_chain_range(&chain, 0, 0, count);
+		}
+		else
+		{
+			// Ranges are whole blocks, so every call to the interpreter sees
+			// the same samples whatever the number of threads.
+			IlmThread::TaskGroup group;
+			IlmThread::ThreadPool *pool = get_ctl_thread_pool(workers);
+
+			for (i = 0; i < workers; i++)
+			{
+				size_t begin = blocks * i / workers * chain.block;
+				size_t end = std::min(count, blocks * (i + 1) / workers * chain.block);
+				pool->addTask(new CTLTask(&group, &chain, i, begin, end));
+			}
+		}
+
+		if (!chain.error.empty())
+		{
+			THROW(Iex::ArgExc, chain.error);
+		}
+
+		if (operation_seconds != NULL)
+		{
+			operation_seconds->resize(chain.stages.size(), 0.0);
+			for (i = 0; i < workers; i++)
+			{
+				for (k = 0; k < chain.stages.size(); k++)
+				{
+					(*operation_seconds)[k] += chain.seconds[i][k];
+				}
+			}
+		}
+
+		// Anything no script produced (alpha through RGB only scripts,
+		// global parameters) is carried through.
+		for (CTLResults::const_iterator r = ctl_results->begin(); r != ctl_results->end(); r++)
+		{
+			if (find_ctl_result(outputs, (*r)->data->name()) == outputs.end())
+			{
+				outputs.push_back(*r);
+			}
+		}
+		*ctl_results = outputs;
+	}
+	catch (...)
+	{
+		release_ctl_chain(&chain);
+		throw;
+	}
+	release_ctl_chain(&chain);
+}
+
+bool source_alpha_used(const CTLOperations &ctl_operations, const format_t &format, const Lut3D *lut)
+{
+	bool made = false;
+
+	if (lut != NULL)
+	{
+		return !format.squish;
+	}
+	for (CTLOperations::const_iterator op = ctl_operations.begin(); op != ctl_operations.end(); op++)
+	{
+		ctl_module_t *module = load_ctl_module(op->filename);
+		std::vector<Ctl::FunctionCallPtr> fns;
+		bool reads = false;
+		bool makes = false;
+
+		try
+		{
+			acquire_ctl_function_calls(module, 1, &fns);
+			for (size_t i = 0; i < fns[0]->numInputArgs(); i++)
+			{
+				reads = reads || channel_index(fns[0]->inputArg(i)->name()) == 3;
+			}
+			for (size_t i = 0; i < fns[0]->numOutputArgs(); i++)
+			{
+				makes = makes || channel_index(fns[0]->outputArg(i)->name()) == 3;
+			}
+		}
+		catch (...)
+		{
+			return_ctl_function_calls(module, &fns);
+			release_ctl_module(module);
+			throw;
+		}
+		return_ctl_function_calls(module, &fns);
+		release_ctl_module(module);
+
+		if (reads && !made)
+		{
+			return true;
+		}
+		made = made || makes;
+	}
+	// Otherwise it only reaches the output when no script replaced it.
+	return !format.squish && !made;
+}
+
+void run_ctl_transform(const ctl_operation_t &ctl_operation, CTLResults *ctl_results, size_t count, int threads)
+{
+	run_ctl_chain(CTLOperations(1, ctl_operation), ctl_results, count, threads);
+}
+
+void prepare_ctl_chain(const CTLOperations &ctl_operations, int threads)
+{
+	for (CTLOperations::const_iterator op = ctl_operations.begin(); op != ctl_operations.end(); op++)
+	{
+		ctl_module_t *module = load_ctl_module(op->filename);
+		std::vector<Ctl::FunctionCallPtr> fns;
+
+		// The calls go back to the module's idle ones, where the workers
+		// of the next chain find them.
+		try
+		{
+			acquire_ctl_function_calls(module, ctl_worker_count(threads), &fns);
+			for (size_t i = 0; i < fns[0]->numOutputArgs(); i++)
+			{
+				Ctl::FunctionArgPtr arg = fns[0]->outputArg(i);
+				if (arg->type().cast<Ctl::FloatType>().refcount() == 0 && arg->type().cast<Ctl::HalfType>().refcount() == 0)
+				{
+					THROW(Iex::ArgExc, "CTL script not providing half or float as the output data type.");
+				}
+			}
+		}
+		catch (...)
+		{
+			return_ctl_function_calls(module, &fns);
+			release_ctl_module(module);
+			throw;
+		}
+		return_ctl_function_calls(module, &fns);
+		release_ctl_module(module);
+	}
+}
+
+void mkimage(ctl::dpx::fb<float> *image_buffer, const CTLResults &ctl_results, format_t *image_format)
+{
+	CTLResultPtr channels[4];
+	bool have[4] = { false, false, false, false };
+	uint32_t depth;
+
+	for (CTLResults::const_iterator i = ctl_results.begin(); i != ctl_results.end(); i++)
+	{
+		int c = channel_index((*i)->data->name());
+		if (c >= 0 && (*i)->varying && !have[c])
+		{
+			channels[c] = *i;
+			have[c] = true;
+		}
+	}
+
+	if (!have[0] && !have[2] && have[1])
+	{
+		// Single channel source, only 'G' was provided.
+		channels[0] = channels[2] = channels[1];
+		have[0] = have[2] = true;
+	}
+	if (!have[0] || !have[1] || !have[2])
+	{
+		THROW(Iex::ArgExc, "Unable to determine what channels from the CTL script output should be saved.");
+	}
+
+	depth = have[3] && !image_format->squish ? 4 : 3;
+	if (image_buffer->depth() != depth)
+	{
+		image_buffer->init(image_buffer->width(), image_buffer->height(), depth);
+	}
+
+	for (uint32_t c = 0; c < depth; c++)
+	{
+		channels[c]->data->get(image_buffer->ptr() + c, depth * sizeof(float), 0, image_buffer->pixels());
+	}
+}
+
+// Decodes a whole file through one of the in-tree strip readers, which
+// takes reader over. False when reader is NULL, that is when it does not
+// handle the file.
+static bool read_strip_image(StripReader *reader, ctl::dpx::fb<float> *image_buffer, format_t *image_format)
+{
+	std::auto_ptr<StripReader> owned(reader);
+
+	if (owned.get() == NULL)
+	{
+		return false;
+	}
+	image_buffer->init(owned->width(), owned->height(), owned->channels());
+	owned->read(0, owned->height(), image_buffer->ptr());
+	*image_format = owned->format();
+	return true;
+}
+
+void read_image(const char *inputFile, float input_scale, ctl::dpx::fb<float> *image_buffer, format_t *image_format, bool alpha)
+{
+	// ctlrender's exr reader always decodes alpha, the strip reader can
+	// leave it out.
+	if (!alpha && read_strip_image(exr_strip_reader(inputFile, input_scale, false), image_buffer, image_format))
+	{
+		return;
+	}
+	if (exr_read(inputFile, input_scale, image_buffer, image_format))
+	{
+		return;
+	}
+	// Dpx and tiff layouts the strip readers handle are decoded straight
+	// from a mapping of the file and with the vector conversions in
+	// tiff_convert.cc respectively. The rest go to dpx_read and tiff_read.
+	if (read_strip_image(dpx_strip_reader(inputFile, input_scale), image_buffer, image_format))
+	{
+		return;
+	}
+	if (dpx_read(inputFile, input_scale, image_buffer, image_format))
+	{
+		return;
+	}
+	if (read_strip_image(tiff_strip_reader(inputFile, input_scale), image_buffer, image_format))
+	{
+		return;
+	}
+	if (tiff_read(inputFile, input_scale, image_buffer, image_format))
+	{
+		return;
+	}
+	THROW(Iex::ArgExc, "unable to read file " << inputFile << " (unknown format).");
+}
+
+// Only the in-tree exr writer tiles, and it writes half and float samples,
+// so tiled output of other bit depths is raised to the nearest of them
+// rather than left to exr_write, which would write scanlines.
+static void tiled_exr_format(format_t *format, const exr_tiling_t &tiling)
+{
+	if (tiling.width > 0 && format->ext != NULL && !strcasecmp(format->ext, "exr") &&
+	    format->bps != 16 && format->bps != 32)
+	{
+		format->bps = format->bps > 16 ? 32 : 16;
+	}
+}
+
+void write_image(const char *outputFile, float output_scale, const ctl::dpx::fb<float> &image_buffer, format_t *format, Compression *compression, const exr_tiling_t &tiling)
+{
+	tiled_exr_format(format, tiling);
+	// The in-tree writers convert samples in bulk, hand exr scanlines to
+	// the encoder in place and buffer dpx output in large writes. Bit
+	// depths they do not write go to ctlrender's writers.
+	if (can_write_strips(*format))
+	{
+		std::auto_ptr<StripWriter> writer(open_strip_writer(outputFile, output_scale, image_buffer.width(), image_buffer.height(), image_buffer.depth(), *format, compression, tiling));
+		writer->write(image_buffer.height(), image_buffer.ptr());
+		writer->finish();
+	}
+	else if (!strcasecmp(format->ext, "exr"))
+	{
+		exr_write(outputFile, output_scale, image_buffer, format, compression);
+	}
+	else if (!strcasecmp(format->ext, "aces"))
+	{
+		aces_write(outputFile, output_scale, image_buffer.width(), image_buffer.height(), image_buffer.depth(), image_buffer.ptr(), format);
+	}
+	else if (!strcasecmp(format->ext, "dpx"))
+	{
+		dpx_write(outputFile, output_scale, image_buffer, format);
+	}
+	else if (!strcasecmp(format->ext, "tif") || !strcasecmp(format->ext, "tiff"))
+	{
+		tiff_write(outputFile, output_scale, image_buffer, format);
+	}
+	else
+	{
+		THROW(Iex::ArgExc, "unable to write a " << format->ext << " file (unknown format).");
+	}
+}
+
+// The CTL inputs for an image: its first channels (at most 4), then the
+// global parameters.
+static void image_ctl_results(const ctl::dpx::fb<float> &image_buffer, uint32_t channels, const CTLParameters &global_ctl_parameters, CTLResults *ctl_results)
+{
+	static const char *channel_names[] = { "R", "G", "B", "A" };
+
+	if (image_buffer.depth() < 3)
+	{
+		ctl_results->push_back(mkresult("G", image_buffer, 0));
+	}
+	else
+	{
+		for (uint32_t c = 0; c < image_buffer.depth() && c < channels; c++)
+		{
+			ctl_results->push_back(mkresult(channel_names[c], image_buffer, c));
+		}
+	}
+
+	for (CTLParameters::const_iterator p = global_ctl_parameters.begin(); p != global_ctl_parameters.end(); p++)
+	{
+		add_parameter_value_to_ctl_results(ctl_results, *p);
+	}
+}
+
+// transform_buffer with the number of channels of image_buffer the
+// operations are given.
+static void transform_channels(ctl::dpx::fb<float> *image_buffer, uint32_t channels, format_t *format, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut, transform_stats_t *stats)
+{
+	CTLResults ctl_results;
+	double start = wall_clock();
+
+	if (stats != NULL)
+	{
+		stats->pixels += image_buffer->pixels();
+	}
+
+	if (lut != NULL)
+	{
+		lut->apply(image_buffer, format);
+		if (stats != NULL)
+		{
+			stats->lut += wall_clock() - start;
+		}
+		return;
+	}
+
+	image_ctl_results(*image_buffer, channels, global_ctl_parameters, &ctl_results);
+
+	if (stats != NULL)
+	{
+		stats->mkresult += wall_clock() - start;
+	}
+
+	run_ctl_chain(ctl_operations, &ctl_results, image_buffer->pixels(), options.threads, stats != NULL ? &stats->operations : NULL);
+
+	start = wall_clock();
+	mkimage(image_buffer, ctl_results, format);
+	if (stats != NULL)
+	{
+		stats->mkimage += wall_clock() - start;
+	}
+}
+
+void transform_buffer(ctl::dpx::fb<float> *image_buffer, format_t *format, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut, transform_stats_t *stats)
+{
+	uint32_t channels = image_buffer->depth() < 4 || source_alpha_used(ctl_operations, *format, lut) ? 4 : 3;
+
+	transform_channels(image_buffer, channels, format, ctl_operations, global_ctl_parameters, options, lut, stats);
+}
+
+// A format without an extension or bit depth means 'the same as the
+// source image'.
+static format_t resolve_output_format(const format_t &format, const format_t &image_format, const exr_tiling_t &tiling)
+{
+	format_t output_format = format;
+
+	if (output_format.ext == NULL)
+	{
+		output_format.ext = image_format.ext;
+	}
+	if (output_format.bps == 0)
+	{
+		output_format.bps = image_format.bps;
+	}
+	tiled_exr_format(&output_format, tiling);
+	return output_format;
+}
+
+static void print_transform(const char *inputFile, const char *outputFile, float input_scale, float output_scale, const format_t &output_format)
+{
+	if (verbosity > 1)
+	{
+		fprintf(stderr, "       source file: %s\n", inputFile);
+		fprintf(stderr, "  destination file: %s\n", outputFile);
+		fprintf(stderr, "destination format: %s\n", output_format.ext);
+		fprintf(stderr, "       input scale: %f\n", input_scale);
+		fprintf(stderr, "      output scale: %f\n", output_scale);
+	}
+}
+
+// Reads, evaluates and writes options.strip_rows scanlines at a time, so
+// only one strip of the frame and of its CTL results is ever in memory.
+// That is only the same as transforming the whole frame because every
+// pixel is evaluated on its own. Returns false, having done nothing, when
+// either file cannot be streamed.
+static bool transform_strips(const char *inputFile, const char *outputFile, float input_scale, float output_scale, format_t *format, Compression *compression, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut, transform_stats_t *stats)
+{
+	uint32_t strip_rows = options.strip_rows;
+	bool alpha = source_alpha_used(ctl_operations, *format, lut);
+	double start = wall_clock();
+	std::auto_ptr<StripReader> reader(open_strip_reader(inputFile, input_scale, alpha));
+	std::auto_ptr<StripWriter> writer;
+	PooledFrame pooled;
+	ctl::dpx::fb<float> &strip = *pooled.get();
+
+	if (reader.get() == NULL || reader->height() == 0)
+	{
+		return false;
+	}
+	stats->read += wall_clock() - start;
+	format_t output_format = resolve_output_format(*format, reader->format(), options.tiling);
+	if (!can_write_strips(output_format))
+	{
+		return false;
+	}
+	print_transform(inputFile, outputFile, input_scale, output_scale, output_format);
+
+	for (uint32_t y = 0; y < reader->height(); y += strip_rows)
+	{
+		uint32_t rows = std::min(strip_rows, reader->height() - y);
+
+		start = wall_clock();
+		strip.init(reader->width(), rows, reader->channels());
+		reader->read(y, rows, strip.ptr());
+		stats->read += wall_clock() - start;
+
+		transform_channels(&strip, alpha ? 4 : 3, &output_format, ctl_operations, global_ctl_parameters, options, lut, stats);
+
+		// Whether there is an alpha channel to write is only known once
+		// the scripts have run.
+		start = wall_clock();
+		if (writer.get() == NULL)
+		{
+			writer.reset(open_strip_writer(outputFile, output_scale, reader->width(), reader->height(), strip.depth(), output_format, compression, options.tiling));
+		}
+		writer->write(rows, strip.ptr());
+		stats->write += wall_clock() - start;
+	}
+	start = wall_clock();
+	writer->finish();
+	stats->write += wall_clock() - start;
+	return true;
+}
+
+SweepResults::~SweepResults()
+{
+}
+
+void transform_sweep(const ctl::dpx::fb<float> &image_buffer, const format_t &image_format, const format_t &format, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const char *name, const std::vector<float> &values, SweepResults *results)
+{
+	CTLOperations operations(ctl_operations);
+	std::vector<float *> locals;
+	CTLResults inputs;
+	PooledFrame pooled((uint64_t) image_buffer.pixels() * image_buffer.depth());
+	ctl::dpx::fb<float> &result = *pooled.get();
+	double start = wall_clock();
+
+	for (CTLOperations::iterator op = operations.begin(); op != operations.end(); op++)
+	{
+		for (CTLParameters::iterator p = op->local.begin(); p != op->local.end(); p++)
+		{
+			if (!strcmp(p->name, name))
+			{
+				locals.push_back(p->value);
+			}
+		}
+	}
+	image_ctl_results(image_buffer, source_alpha_used(ctl_operations, format) ? 4 : 3, global_ctl_parameters, &inputs);
+	double mkresult_seconds = wall_clock() - start;
+
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		transform_stats_t stats;
+		format_t result_format = resolve_output_format(format, image_format, options.tiling);
+		CTLResults ctl_results(inputs);
+
+		start = wall_clock();
+		if (locals.empty())
+		{
+			ctl_parameter_t parameter;
+			parameter.name = name;
+			parameter.count = 1;
+			parameter.value[0] = values[i];
+			add_parameter_value_to_ctl_results(&ctl_results, parameter);
+		}
+		for (size_t j = 0; j < locals.size(); j++)
+		{
+			*locals[j] = values[i];
+		}
+		// The first value is charged with making the inputs.
+		stats.pixels = image_buffer.pixels();
+		stats.mkresult = (i == 0 ? mkresult_seconds : 0.0) + wall_clock() - start;
+
+		run_ctl_chain(operations, &ctl_results, image_buffer.pixels(), options.threads, &stats.operations);
+
+		start = wall_clock();
+		if (i == 0)
+		{
+			result.init(image_buffer.width(), image_buffer.height(), image_buffer.depth());
+		}
+		mkimage(&result, ctl_results, &result_format);
+		stats.mkimage = wall_clock() - start;
+
+		if (!results->add(i, &result, &result_format, &stats))
+		{
+			break;
+		}
+	}
+}
+
+void transform_decoded(const char *inputFile, const char *outputFile, float input_scale, float output_scale, ctl::dpx::fb<float> *image_buffer, const format_t &image_format, format_t *format, Compression *compression, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut, transform_stats_t *stats)
+{
+	stats->input = inputFile;
+	stats->output = outputFile;
+	stats->bytes_read = file_size(inputFile);
+
+	format_t output_format = resolve_output_format(*format, image_format, options.tiling);
+	print_transform(inputFile, outputFile, input_scale, output_scale, output_format);
+
+	transform_buffer(image_buffer, &output_format, ctl_operations, global_ctl_parameters, options, lut, stats);
+
+	double start = wall_clock();
+	write_image(outputFile, output_scale, *image_buffer, &output_format, compression, options.tiling);
+	stats->write += wall_clock() - start;
+	stats->bytes_written = file_size(outputFile);
+}
+
+void transform(const char *inputFile, const char *outputFile, float input_scale, float output_scale, format_t *format, Compression *compression, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut, transform_stats_t *stats)
+{
+	PooledFrame pooled;
+	ctl::dpx::fb<float> &image_buffer = *pooled.get();
+	format_t image_format;
+	transform_stats_t unused;
+	double begin = wall_clock();
+	double start;
+
+	if (stats == NULL)
+	{
+		stats = &unused;
+	}
+	stats->input = inputFile;
+	stats->output = outputFile;
+	stats->bytes_read = file_size(inputFile);
+
+	if (options.strip_rows <= 0 || !transform_strips(inputFile, outputFile, input_scale, output_scale, format, compression, ctl_operations, global_ctl_parameters, options, lut, stats))
+	{
+		bool alpha = source_alpha_used(ctl_operations, *format, lut);
+		start = wall_clock();
+		read_image(inputFile, input_scale, &image_buffer, &image_format, alpha);
+		stats->read += wall_clock() - start;
+
+		transform_decoded(inputFile, outputFile, input_scale, output_scale, &image_buffer, image_format, format, compression, ctl_operations, global_ctl_parameters, options, lut, stats);
+	}
+
+	stats->bytes_written = file_size(outputFile);
+	stats->total = wall_clock() - begin;
+}
@@ -0,0 +1,244 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Academy of Motion Picture Arts and Sciences 
+// ("A.M.P.A.S."). Portions contributed by others as indicated.
+// All rights reserved.
+// 
+// A worldwide, royalty-free, non-exclusive right to copy, modify, create
+// derivatives, and use, in source and binary forms, is hereby granted, 
+// subject to acceptance of this license. Performance of any of the 
+// aforementioned acts indicates acceptance to be bound by the following 
+// terms and conditions:
+//
+//  * Copies of source code, in whole or in part, must retain the 
+//    above copyright notice, this list of conditions and the 
+//    Disclaimer of Warranty.
+//
+//  * Use in binary form must retain the above copyright notice, 
+//    this list of conditions and the Disclaimer of Warranty in the
+//    documentation and/or other materials provided with the distribution.
+//
+//  * Nothing in this license shall be deemed to grant any rights to 
+//    trademarks, copyrights, patents, trade secrets or any other 
+//    intellectual property of A.M.P.A.S. or any contributors, except 
+//    as expressly stated herein.
+//
+//  * Neither the name "A.M.P.A.S." nor the name of any other 
+//    contributors to this software may be used to endorse or promote 
+//    products derivative of or based on this software without express 
+//    prior written permission of A.M.P.A.S. or the contributors, as 
+//    appropriate.
+// 
+// This license shall be construed pursuant to the laws of the State of 
+// California, and any disputes related thereto shall be subject to the 
+// jurisdiction of the courts therein.
+//
+// Disclaimer of Warranty: THIS SOFTWARE IS PROVIDED BY A.M.P.A.S. AND 
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, 
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS 
+// FOR A PARTICULAR PURPOSE, AND NON-INFRINGEMENT ARE DISCLAIMED. IN NO 
+// EVENT SHALL A.M.P.A.S., OR ANY CONTRIBUTORS OR DISTRIBUTORS, BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, RESITUTIONARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// WITHOUT LIMITING THE GENERALITY OF THE FOREGOING, THE ACADEMY 
+// SPECIFICALLY DISCLAIMS ANY REPRESENTATIONS OR WARRANTIES WHATSOEVER 
+// RELATED TO PATENT OR OTHER INTELLECTUAL PROPERTY RIGHTS IN THE ACADEMY 
+// COLOR ENCODING SYSTEM, OR APPLICATIONS THEREOF, HELD BY PARTIES OTHER 
+// THAN A.M.P.A.S., WHETHER DISCLOSED OR UNDISCLOSED.
+///////////////////////////////////////////////////////////////////////////
+
+#if !defined(CTL_UTIL_CTLRENDER_TRANSFORM_INCLUDE)
+#define CTL_UTIL_CTLRENDER_TRANSFORM_INCLUDE
+
+#include "main.hh"
+#include <list>
+#include <string>
+#include <vector>
+#include <dpx.hh>
+#include <CtlRcPtr.h>
+#include <CtlType.h>
+
+struct ctl_parameter_t
+{
+	const char *name;
+	uint8_t count;
+	float value[3];
+};
+typedef std::list<ctl_parameter_t> CTLParameters;
+
+struct ctl_operation_t
+{
+	const char *filename;
+	CTLParameters local;
+};
+typedef std::list<ctl_operation_t> CTLOperations;
+
+class Lut3D;
+
+// One channel (or one parameter) flowing between CTL operations. Image
+// channels are varying and hold one sample per pixel, parameters hold a
+// single (possibly array valued) sample.
+class CTLResult: public Ctl::RcObject
+{
+	public:
+		CTLResult();
+		virtual ~CTLResult();
+
+		Ctl::TypeStoragePtr data;
+		bool varying;
+};
+typedef Ctl::RcPtr<CTLResult> CTLResultPtr;
+typedef std::list<CTLResultPtr> CTLResults;
+
+// Where the time of one frame went. Everything is wall clock seconds
+// except operations, which holds, per -ctl operation, the evaluation time
+// summed over every thread that ran it. A cached frame was taken from a
+// RenderCache and only has its total time.
+struct transform_stats_t
+{
+	transform_stats_t();
+
+	std::string input;
+	std::string output;
+	double pixels;
+	double read;
+	double mkresult;
+	std::vector<double> operations;
+	double lut;
+	double mkimage;
+	double write;
+	double total;
+	double bytes_read;
+	double bytes_written;
+	bool cached;
+};
+
+// Settings a job hands down to every frame it transforms. They are kept
+// by the job rather than read from globals, so that a call made while an
+// asynchronous job runs leaves that job's frames alone.
+struct transform_options_t
+{
+	transform_options_t();
+
+	// Scanlines read, transformed and written at a time, 0 for whole frames.
+	int strip_rows;
+
+	// Threads CTL evaluation is split over, 0 for one per processor.
+	int threads;
+
+	// Tiling of exr output.
+	exr_tiling_t tiling;
+};
+
+// Seconds since some fixed point, for timing.
+double wall_clock();
+
+// Size of filename in bytes, 0 when it cannot be found.
+double file_size(const char *filename);
+
+CTLResultPtr mkresult(const char *name, const ctl::dpx::fb<float> &image_buffer, size_t offset);
+void mkimage(ctl::dpx::fb<float> *image_buffer, const CTLResults &ctl_results, format_t *image_format);
+void add_parameter_value_to_ctl_results(CTLResults *ctl_results, const ctl_parameter_t &parameter);
+void run_ctl_transform(const ctl_operation_t &ctl_operation, CTLResults *ctl_results, size_t count, int threads);
+
+// Runs every operation over one block of samples before moving on to the
+// next block, so intermediate results stay in cache rather than going
+// through a frame sized buffer per operation.
+// The image is split over ctl_worker_count(threads) workers. When
+// operation_seconds is given it receives the evaluation time of each
+// operation.
+void run_ctl_chain(const CTLOperations &ctl_operations, CTLResults *ctl_results, size_t count, int threads, std::vector<double> *operation_seconds = NULL);
+
+// Loads and compiles every operation and readies a function call for
+// each of the workers of threads, so that the first frame run through them
+// does not pay for it. Throws as run_ctl_chain would for a script that
+// cannot be used.
+void prepare_ctl_chain(const CTLOperations &ctl_operations, int threads);
+
+// Releases every CTL module kept loaded between calls.
+void flush_ctl_module_cache();
+
+// The files the modules a CTL script imports (and those they import in
+// turn) may be taken from: each '<module>.ctl' next to the importing
+// file, in the directories of CTL_MODULE_PATH or in the current
+// directory. Every candidate is listed rather than the one the
+// interpreter picks, so a change to any of them is seen. Resolved paths,
+// filename itself left out.
+std::vector<std::string> ctl_module_imports(const char *filename);
+
+// Stops the threads that evaluate CTL. Only safe once nothing is running.
+void release_ctl_thread_pool();
+
+// Number of threads run_ctl_chain splits an image over, which is threads
+// or, when that is 0, the number of online processors.
+int ctl_worker_count(int threads);
+
+// Number of online processors.
+int hardware_threads();
+
+// Shares threads (0 for one per processor) between ctl evaluation and the
+// OpenEXR codec pool. Frames that are pipelined decode, evaluate and encode
+// at once, so the two pools split the budget between them; otherwise each
+// runs in turn and gets all of it. The codec pool is resized here, the
+// threads left to evaluation are returned for the job's
+// transform_options_t::threads.
+int set_thread_budget(int threads, bool pipelined);
+
+// Threads the OpenEXR codec pool was last given by set_thread_budget.
+int exr_thread_count();
+
+// Whether the alpha of a source image is used: read by one of the
+// operations before any of them makes an alpha of its own, or carried
+// through to an output format that keeps alpha. A lut passes the source
+// alpha on, so with one only the format decides.
+bool source_alpha_used(const CTLOperations &ctl_operations, const format_t &format, const Lut3D *lut = NULL);
+
+// Decodes inputFile into image_buffer. image_format receives the format and
+// bit depth of the file that was read. Without alpha the alpha channel of
+// an exr file is not decoded; other files keep theirs.
+void read_image(const char *inputFile, float input_scale, ctl::dpx::fb<float> *image_buffer, format_t *image_format, bool alpha = true);
+
+// Encodes image_buffer into outputFile using the extension and bit depth
+// in format. Tiled exr output is only written as half or float samples,
+// so other bit depths are raised to the nearest of the two.
+void write_image(const char *outputFile, float output_scale, const ctl::dpx::fb<float> &image_buffer, format_t *format, Compression *compression, const exr_tiling_t &tiling = exr_tiling_t());
+
+// Runs the CTL operations over an image that is already in memory. The
+// result replaces the contents of image_buffer. When lut is given it is a
+// baked version of the operations and is applied instead. Time spent is
+// added to stats when given. An alpha channel source_alpha_used says is
+// not used is not handed to the operations.
+void transform_buffer(ctl::dpx::fb<float> *image_buffer, format_t *format, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut = NULL, transform_stats_t *stats = NULL);
+
+// The evaluation and writing half of transform, for an image that has
+// already been read from inputFile. image_format is the format read_image
+// gave. stats must be given, and is filled in except for the read and
+// total times.
+void transform_decoded(const char *inputFile, const char *outputFile, float input_scale, float output_scale, ctl::dpx::fb<float> *image_buffer, const format_t &image_format, format_t *format, Compression *compression, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut, transform_stats_t *stats);
+
+// Receives the results of transform_sweep, one per value in order. The
+// add() of value i may add its write time to stats, and returns false to
+// stop the sweep there.
+class SweepResults
+{
+	public:
+		virtual ~SweepResults();
+		virtual bool add(size_t i, ctl::dpx::fb<float> *image_buffer, format_t *format, transform_stats_t *stats) = 0;
+};
+
+// Runs the CTL operations over image_buffer once for each of values given
+// to the parameter name, leaving image_buffer as it was. That is a local
+// parameter of the operations that set it with -param1, a global one
+// otherwise. The CTL inputs are made from the image once and only the
+// parameter is bound again for each value. format is the output format,
+// resolved against image_format as transform does.
+void transform_sweep(const ctl::dpx::fb<float> &image_buffer, const format_t &image_format, const format_t &format, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const char *name, const std::vector<float> &values, SweepResults *results);
+
+void transform(const char *inputFile, const char *outputFile, float input_scale, float output_scale, format_t *format, Compression *compression, const CTLOperations &ctl_operations, const CTLParameters &global_ctl_parameters, const transform_options_t &options, const Lut3D *lut = NULL, transform_stats_t *stats = NULL);
+
+#endif